@@ -1,7 +1,9 @@
 /* 
  * Kepler Q1-Q17 DR24 Robovetter
  * 
- * Compile via: g++ -std=c++11 -O3 -o robovet DR24-RoboVetter.cpp
+ * Compile via: make    (or g++ -std=c++17 -O3 -pthread -ffp-contract=off -o robovet DR24-RoboVetter.cpp RoboVetter.cpp)
+ *
+ * The vetting itself is in the robovetter library, RoboVetter.h and RoboVetter.cpp. This file reads and writes the files.
  * 
  * Run as ./robovet INFILE  OUTFILE
  * 
@@ -11,6 +13,71 @@
  * 
  * "./robovet RoboVetter-Inject-Input.txt RoboVetter-Inject-Output.txt"   for the artifically injected transit data
  *
+ * Or, to vet many files in one process, as ./robovet --batch MANIFEST
+ *
+ * Or, to answer vetting requests from other programs, as ./robovet --serve SOCKET
+ *
+ * Or, to check the vetting against the reference engine, as ./robovet --verify INFILE [EXPECTED]
+ *
+ * Options:
+ *
+ *   -j N     Vet KIC systems on N threads (0 = one per core). Output is identical to the serial run.
+ *   --stream Read, vet and write a few KIC systems at a time in constant memory, see STREAMVET. INFILE and OUTFILE
+ *            default to stdin and stdout, or may be given as "-".
+ *   --sweep GRIDFILE   Evaluate every threshold configuration in GRIDFILE (see READGRID) and write
+ *            PC/FP counts per configuration to OUTFILE instead of dispositions.
+ *   --inject INJFILE   With --sweep, also report counts and recovery rates on the injected set INJFILE.
+ *   --ephemmatch   Compute the ephemeris match flag by matching every TCE against every other TCE, and
+ *            against the known eclipsing binaries or KOIs in --ephemlist, instead of reading it from INFILE.
+ *   --ephemlist LISTFILE   Known systems to match against, one "NAME PERIOD EPOCH [RA DEC]" per line.
+ *   --coords COORDFILE   "KIC RA DEC" per line, in degrees. With --ephemmatch, only TCEs within
+ *            EPHEM_RADIUS of each other can match.
+ *   --checkephem   Check that the fast period and epoch matching gives the same decisions as the
+ *            original PSIG and epoch wrapping on every TCE pair in INFILE, and report to the screen. Uses the
+ *            thresholds of --config and --set.
+ *   --verify   Vet INFILE with both the usual code and the reference engine, VETREF, which runs the tests one TCE
+ *            at a time as the original robovet did, and report every flag and minor flag they disagree on, and
+ *            the speedup. Given EXPECTED, a known output file such as RoboVetter-Output.txt for
+ *            RoboVetter-Input.txt, the results are also checked against it. No output file. Exits with status 1
+ *            on any disagreement. Works with -j, --sort, --cache, --ephemmatch, --config, --set and --generic.
+ *   --binout BINFILE   Also write each TCE's KIC, planet number, disposition, flags and minor flags
+ *            to BINFILE as fixed size binary records, see binheader.
+ *   --timing Report the time taken to parse, vet and write, and the rows per second of each, to stderr.
+ *            Not with --stream, --sweep, --checkephem, --verify or --serve.
+ *   --stats STATSFILE   Write counts of how often each test ran and fired, the TCE pairs compared per system,
+ *            and the time taken by each phase and each thread, to STATSFILE as JSON, see WRITESTATS.
+ *            Not with --stream, --sweep, --checkephem, --verify or --serve.
+ *   --mc N   Also score each TCE by vetting it N times with its metrics perturbed within the uncertainties in
+ *            --sigmas, and write the fraction of PC outcomes as an extra output column before the minor flags.
+ *            Not with --stream or --sweep.
+ *   --sigmas SIGFILE   Uncertainties for --mc, "COLUMN SIGMA" per line, see READSIGMAS.
+ *   --seed S With --mc, seed of the perturbations (default 1). The scores only depend on the seed and N.
+ *   --sort   INFILE may be in any order, with planet numbers that have gaps or don't start at 1. The rows are
+ *            sorted into KIC systems (see SORTSYSTEMS) and each TCE is compared against the rest of its system.
+ *            Output stays in input order. Not with --stream or --sweep.
+ *   --keyorder   With --sort, write the output sorted by KIC and planet number instead.
+ *   --cache  Keep a binary copy of each input file next to it, as INFILE.cache, and read that instead of
+ *            the text when it is up to date. It is remade whenever the input file changes.
+ *   --batch MANIFEST   Vet every "INFILE OUTFILE" pair listed in MANIFEST ("-" for stdin), see READMANIFEST. The
+ *            files are parsed at the same time and all their systems are vetted on one pool of -j threads.
+ *            Works with --cache, --ephemmatch, --config, --set and --timing. A file that fails to parse gets no
+ *            output, the others are still written, and the exit status is 1.
+ *   --serve SOCKET   Answer vetting requests on the Unix domain socket SOCKET, or on stdin and stdout for "-",
+ *            until killed, see SERVECONN. Each connection is served on its own thread. Works with --config,
+ *            --set and --generic. roboload (RoboVetter-Load.cpp) measures its latency.
+ *   --ablate REPORTFILE   Also work out which TCEs would change disposition without each test, counting the
+ *            effect on later TCEs of the system, and write a table of them per test to REPORTFILE, see
+ *            WRITEABLATION. Not with --stream or --sweep.
+ *   --config CONFIGFILE   Vet with the thresholds in CONFIGFILE, "NAME VALUE" per line, see READCONFIG. The
+ *            others keep their DR24 values. Applies to every mode, and is the starting point of --sweep grids.
+ *   --set NAME=VALUE   Set one threshold, after any --config. May be given more than once. The names are the
+ *            ones in VET_THRESHOLDS.
+ *   --generic   Vet the DR24 thresholds through the same code as any other thresholds, rather than the copy
+ *            of the tests with the DR24 values built in. Results are identical, this is for benchmarking.
+ *   --incremental STATEFILE   Keep each KIC system's results in STATEFILE with a hash of its input rows, and only
+ *            vet the systems whose rows changed since the run that wrote it, see INCREMENTALVET. Output is
+ *            identical to a full run. Not with --stream, --sweep or --mc.
+ *
  */
 
 
@@ -19,542 +86,2328 @@
 #include <fstream>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <charconv>
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include <math.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glob.h>
+#include <csignal>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include "RoboVetter.h"
 
 using namespace std;
 
-// Declare Functions
-void READDATA(),TRANSITLIKE(),SECECLIPSE(),ISSEC(),COMPPT(double,double,double,double);
-double INVERFC(double), PSIG(double,double), ESIG(double,double,double);
-
-// Declare constants
-const int NMAX = 50000; // Max number of TCEs. Increase as needed.
-const double PSIG_THRESH = 3.25;   // Period matching threshold
-const double ESIG_THRESH = 2.0;    // Epoch matching threshold
-const double WIDTHFAC = 2.5;       // Transit exclusion width actor
-const double MISSIONDUR = 1600.0;  // Mission duration in days
-
 // Declare variables
-int i,j,k,l;  // Counting integers
-int ntces;  // Number of TCEs to robo-vet
+int nthreads=1;  // Number of threads to vet with
+bool streaming=false;  // Read, vet and write one KIC system at a time
 string infilename,outfilename;
-ifstream infile;
-ofstream outfile;
-
-// Declare big struct of all our data
-struct datastruct {string tce,  // TCE string (KIC-PN)
-                     comments;  // Comments from ephemeris match
-  
-                      int kic,  // KIC number
-                           pn,  // Planet Number
-                  num_planets,  // Number of TCEs for the given KIC
-               robo_cent_disp,  // 0 = centroid PC, 1 = centroid FP
-             ephem_match_disp;  // 0 = no ephem match, 1 = ephem match identified
-               
-                double period,  // Period of the system in days from TPS
-                        epoch,  // Epoch from TPS
-               max_ses_in_mes,  // Max SES actually used in the compuation of the MES
-                          mes,  // Max MES from TPS
-                     duration,  // Duration of the transit from DV in hours
-                       impact,  // Impact parameter of the system from DV
-                   dv_sig_pri,  // Significance of primary from  model-shift test on DV flux Data
-                   dv_sig_sec,  // Significance of secondary from  model-shift test on DV flux Data
-                   dv_sig_ter,  // Significance of tertiary from  model-shift test on DV flux Data
-                   dv_sig_pos,  // Significance of positive feature from  model-shift test on DV flux Data
-                    dv_sig_fa,  // False Alarm threshold from  model-shift test on DV flux Data
-                      dv_fred,  // Red Noise / Gaussian Noise  from  model-shift test on DV flux Data
-                    dv_del_fa,  // Delta in sigma value threshold to be considered a distinct feature on DV flux data
-                    dv_ph_pri,  // Phase of primary from  model-shift test on DV flux Data
-                    dv_ph_sec,  // Phase of secondary from  model-shift test on DV flux Data
-                    dv_ph_ter,  // Phase of tertiary from  model-shift test on DV flux Data
-                    dv_ph_pos,  // Phase of positive feature from  model-shift test on DV flux Data
-              dv_mod_pridepth,  // Depth of primary from DV model-shift
-              dv_mod_secdepth,  // Depth of secondary from DV model-shift
-                  alt_sig_pri,  // Significance of primary from  model-shift test on Chris' alternate detrended trapezoid fit data
-                  alt_sig_sec,  // Significance of secondary from  model-shift test on Chris' alternate detrended trapezoid fit data
-                  alt_sig_ter,  // Significance of tertiary from  model-shift test on Chris' alternate detrended trapezoid fit data
-                  alt_sig_pos,  // Significance of positive feature from  model-shift test on Chris' alternate detrended trapezoid fit data
-                   alt_sig_fa,  // False Alarm threshold from  model-shift test on Chris' alternate detrended trapezoid fit data
-                     alt_fred,  // Red Noise / Gaussian Noise  from  model-shift test on Chris' alternate detrended trapezoid fit data
-                   alt_del_fa,  // Delta in sigma value threshold to be considered a distinct feature on alternate detrended trapezoid fit data
-                   alt_ph_pri,  // Phase of primary from  model-shift test on Chris' alternate detrended trapezoid fit data
-                   alt_ph_sec,  // Phase of secondary from  model-shift test on Chris' alternate detrended trapezoid fit data
-                   alt_ph_ter,  // Phase of tertiary from  model-shift test on Chris' alternate detrended trapezoid fit data
-                   alt_ph_pos,  // Phase of positive feature from  model-shift test on Chris' alternate detrended trapezoid fit data
-             alt_mod_pridepth,  // Depth of primary from  model-shift test on Chris' alternate detrended trapezoid fit data      
-             alt_mod_secdepth,  // Depth of secondary from  model-shift test on Chris' alternate detrended trapezoid fit data
-                     dv_oesig,  // Odd-Even test done on the DV data.
-                    alt_oesig,  // Odd-Even test done on the alt data.
-                      lpp_tps,  // Susan's LPP value based on DV detrending
-                     lpp_trap,  // Susan's LPP value based on alt detrending (Chris)
-                       dv_alb,  // Albedo from secondary eclipse monte carlo using model-shift test on DV data
-                        dv_rp,  // Planet Radius from secondary eclipse monte carlo using model-shift test on DV data
-                      alt_alb,  // Albedo from secondary eclipse monte carlo using model-shift test on alternate data
-                       alt_rp,  // Planet Radius from secondary eclipse monte carlo using model-shift test on alternate data
-                     marshall;  // Marshall metric for calculating if at least three transits are transit-like
-                            };
-datastruct data[NMAX];
-int sig_sec_eclipse[NMAX],not_transit_like[NMAX],planet_occultation[NMAX],centroid_offset[NMAX],period_is_double[NMAX],ephemeris_match[NMAX];  // Final disposition Flags. Made arrays so TCEs in same system can know about each other.
-string nexscidisp;  // NEXSCI disposition
-double epochthresh; //Epoch matching threshold for sec. determination
-int secfound;  // Int to mark if a secondary has been found in the system
-double lppsig;  // LPP sigma value, computed based off number of TCEs
-string tmpstr1,tmpstr2;  // Temporary strings
-double tmpdob1,tmpdob2,tmpdob3,tmpdob4,tmpdob5,tmpdob6;  // Temporary doubles for computations
+string sweepfilename,injectfilename;  // Threshold sweep grid, and injected set to report recovery on
+bool checkephem=false;  // Check the fast ephemeris matching against the original instead of vetting
+bool verify=false;  // Check the vetting against the reference engine instead of writing output
+string expectname;  // Known output file to check the vetting against with --verify
+bool ephemmatch=false;  // Compute ephem_match_disp with EPHEMMATCH
+string ephemlistname,coordsname;  // Known EBs/KOIs, and sky positions, for EPHEMMATCH
+bool timing=false;  // Report the time taken by each phase
+string statsname;  // JSON report of test counts and timings
+int mctrials=0;  // Monte Carlo trials per TCE for --mc
+string sigmasname;  // Uncertainties for --mc
+uint64_t mcseed=1;
+vector<double> scores;  // PC fraction of each TCE from --mc, written out when not empty
+bool sortinput=false;  // Sort the input into KIC systems first, see SORTSYSTEMS
+bool keyorder=false;  // ...and write the output in sorted order rather than input order
+vector<int> outrows;  // Row of the tcestore to write as output line i, when not in row order
+bool usecache=false;  // Read the input from a binary cache next to it, see LOADDATA
+string binoutname;  // Binary results file, see binheader
+string statename;  // Results of the last run for --incremental, see stateheader
+vetconfig config;  // Thresholds to vet with, from --config and --set
+string ablatename;  // Report of the effect of leaving out each test, see WRITEABLATION
+string batchname;  // Manifest of input and output files for --batch
+string servename;  // Socket to answer requests on for --serve, or "-" for stdin and stdout
+ofstream outfile,binfile;
+
+// Input columns following the TCE string, in file order. The centroid and ephemeris match dispositions follow these.
+column<double> tcestore::* const INCOLS[] = {&tcestore::period,&tcestore::epoch,&tcestore::duration,&tcestore::max_ses_in_mes,&tcestore::mes,
+  &tcestore::lpp_tps,&tcestore::lpp_trap,&tcestore::marshall,&tcestore::dv_oesig,&tcestore::alt_oesig,
+  &tcestore::dv_sig_pri,&tcestore::dv_sig_sec,&tcestore::dv_sig_ter,&tcestore::dv_sig_pos,&tcestore::dv_fred,&tcestore::dv_sig_fa,&tcestore::dv_del_fa,
+  &tcestore::alt_sig_pri,&tcestore::alt_sig_sec,&tcestore::alt_sig_ter,&tcestore::alt_sig_pos,&tcestore::alt_fred,&tcestore::alt_sig_fa,&tcestore::alt_del_fa,
+  &tcestore::dv_rp,&tcestore::impact,&tcestore::dv_alb,&tcestore::dv_mod_pridepth,&tcestore::dv_mod_secdepth,&tcestore::dv_ph_sec,
+  &tcestore::alt_alb,&tcestore::alt_mod_pridepth,&tcestore::alt_mod_secdepth,&tcestore::alt_ph_sec};
+const int NINCOLS = sizeof(INCOLS)/sizeof(INCOLS[0]);
+
+// Start of a --cache file. The columns follow in the order of TCE_INT_COLUMNS and then TCE_DOUBLE_COLUMNS, then
+// the TCE strings as nrows+1 offsets into a block of characters. Each section starts on a CACHEALIGN boundary.
+const uint64_t CACHEVERSION = 1;
+const size_t CACHEALIGN = 64;
+struct cacheheader {char magic[8];  // "RVCACHE"
+                    uint64_t version;  // CACHEVERSION
+                    uint64_t layout;  // Hash of the column names and types, so changing the columns invalidates old caches
+                    uint64_t nrows;
+                    uint64_t src[4];  // Size, modification time in s and ns, and inode of the input it was made from
+                    uint64_t size;  // Of the whole file
+                    uint64_t checksum;  // Of everything after the header, see CHECKSUM
+                   };
+
+// Start of a --binout results file. The names of the minor flags follow, in bit order as NUL terminated strings
+// padded with NULs to namesize bytes, and then one binresult per TCE in output order. Numbers are in the byte order
+// of the machine that wrote the file, so version reads as 1 on a machine with the same byte order.
+const uint32_t BINVERSION = 1;
+struct binheader {char magic[8];  // "RVRESULT"
+                  uint32_t version;  // BINVERSION
+                  uint32_t recsize;  // sizeof(binresult)
+                  uint64_t nrows;
+                  uint32_t nflags;  // Number of minor flag names
+                  uint32_t namesize;  // Bytes of minor flag names, a multiple of 8
+                 };
+struct binresult {int32_t kic;
+                  int16_t pn;
+                  uint8_t fp;  // NExScI disposition, 1 = FP, 0 = PC
+                  uint8_t flags;  // Bit 0 not transit-like, 1 significant secondary, 2 centroid offset, 3 ephemeris match
+                  uint32_t minorflags;  // Bit f set for minor flag f
+                 };
+
+// Start of an --incremental state file. One stategroup per group of rows (see FINDGROUPS) follows, then one
+// stateresult per row, then zeros up to a multiple of 32 bytes. It is only used by a run with the same columns,
+// thresholds and flags as the one that wrote it.
+const uint64_t STATEVERSION = 2;
+struct stateheader {char magic[8];  // "RVSTATE"
+                    uint64_t version;  // STATEVERSION
+                    uint64_t layout;  // LAYOUTHASH
+                    uint64_t config;  // CONFIGHASH of the thresholds
+                    uint64_t input;  // INPUTHASH of the rows
+                    uint64_t ngroups;
+                    uint64_t nrows;
+                    uint64_t checksum;  // Of everything after the header, see CHECKSUM
+                   };
+struct stategroup {uint64_t hash;  // From HASHGROUPS
+                   uint64_t first;  // First stateresult of the group
+                   uint64_t nrows;
+                  };
+struct stateresult {uint32_t flags;  // Bit 0 not transit-like, 1 significant secondary, 2 planet occultation, 3 centroid offset, 4 period is double, 5 ephemeris match
+                    uint32_t minorflags;
+                   };
+
+
+// Declare Functions
+int READDATA(const string&,tcestore&,string *err=nullptr), LOADDATA(const string&,tcestore&,string *err=nullptr);
+bool READCACHE(const string&,const uint64_t*,tcestore&), SRCSTAT(const string&,uint64_t*);
+void WRITECACHE(const string&,const uint64_t*,const tcestore&);
+uint64_t CACHELAYOUT(uint64_t,uint64_t,vector<uint64_t>&), CHECKSUM(const char*,size_t), LAYOUTHASH(), CONFIGHASH(const vetconfig&), STATESIZE(uint64_t,uint64_t), INPUTHASH(const tcestore&);
+void INCREMENTALVET(const tcestore&,const vetconfig&,flagstore&,vector<vetstats>*);
+bool PARSEROW(tcestore&,const string&,const char*,const char*,int,int,string *err=nullptr), ROWERROR(const string&,int,const string&,string*);
+void STREAMVET(const vetconfig&),VETSYSTEM(ostream&,tcestore&,flagstore&,const vetconfig&,int),SWEEP(),CHECKEPHEM(),EPHEMMATCHFILES(tcestore&,const vetconfig&);
+void VERIFY(),READEXPECTED(const string&,const tcestore&,const vector<int>&,flagstore&);
+long REPORTDIFFS(const char*,const char*,const tcestore&,const vector<int>&,const flagstore&,const flagstore&);
+coordmap READCOORDS(const string&);
+void READEPHEMLIST(const string&,const coordmap&,vector<ephement>&);
+vector<vetconfig> READGRID(const string&);
+void READCONFIG(const string&,vetconfig&);
+void BATCH(), SERVE(), SERVECONN(int,int);
+bool WRITEALL(int,const string&);
+vector<pair<string,string> > READMANIFEST(const string&);
+string PROMPT(const char*);
+bool SETTHRESH(const string&,vetconfig&,string&);
+int FINDTHRESH(const string&), FINDCOLUMN(const string&);
+void READSIGMAS(const string&,mcsigmas&);
+bool TODOUBLE(const string&,double&);
+void WRITEBINHEADER(ostream&,uint64_t),WRITEBINARY(ostream&,const tcestore&,const flagstore&,int,int);
+void WRITEHEADER(ostream&),WRITEOUTPUT(ostream&,const tcestore&,const flagstore&,int,int),WRITEFLAGS(string&,uint32_t),FORMATROWS(string&,const tcestore&,const flagstore&,int,int);
+void PARSEERROR(const string&,int,string), REPORTTIME(const char*,chrono::steady_clock::duration,int);
+void WRITESTATS(ostream&,const vector<vetstats>&,const chrono::steady_clock::time_point*);
+void WRITEABLATION(ostream&,const tcestore&,const flagstore&,const vector<uint64_t>&);
+bool ISSPACE(char), DECODETCE(const char*,const char*,int&,int&);
+const char* SKIPSPACE(const char*,const char*);
+template <typename T> const char* PARSENUM(const char*,const char*,T&);
 
 
 int main (int argc, char* argv[])  
   {   
   
-  // Get Command Line Inputs
-  if(argc>1)
-    infilename = argv[1];
-  else
+  // Get Command Line Inputs. Options may go anywhere, the remaining arguments are the input and output filenames.
+  vector<string> args,sets;
+  string configname;
+  for(int a=1;a<argc;a++)
     {
-    cout << "Name of intput file? ";
-    cin >> infilename;
-    }    
-    
-  if(argc>2)
-    outfilename = argv[2];
+    string opt = argv[a];
+    if(opt=="-j" && a+1<argc)  // Number of threads, 0 for one per core
+      nthreads = atoi(argv[++a]);
+    else if(opt.compare(0,2,"-j")==0 && opt.size()>2)
+      nthreads = atoi(opt.c_str()+2);
+    else if(opt=="--stream")  // Bounded memory, one system at a time. Filenames default to stdin/stdout.
+      streaming = true;
+    else if(opt=="--sweep" && a+1<argc)  // Evaluate every threshold configuration in a grid file. OUTFILE gets the report.
+      sweepfilename = argv[++a];
+    else if(opt=="--inject" && a+1<argc)  // With --sweep, also report recovery of this injected set
+      injectfilename = argv[++a];
+    else if(opt=="--checkephem")  // Report on the fast ephemeris matching, no output file
+      checkephem = true;
+    else if(opt=="--verify")  // Report on the vetting against the reference engine, no output file
+      verify = true;
+    else if(opt=="--ephemmatch")  // Work out ephem_match_disp here rather than taking it from the input
+      ephemmatch = true;
+    else if(opt=="--ephemlist" && a+1<argc)  // Known EBs/KOIs for --ephemmatch
+      ephemlistname = argv[++a];
+    else if(opt=="--coords" && a+1<argc)  // Sky positions for the --ephemmatch distance cut
+      coordsname = argv[++a];
+    else if(opt=="--binout" && a+1<argc)  // Also write the dispositions and flags to a binary file
+      binoutname = argv[++a];
+    else if(opt=="--timing")  // Time parsing, vetting and writing
+      timing = true;
+    else if(opt=="--stats" && a+1<argc)  // Count what the tests did, and time it, into a JSON file
+      statsname = argv[++a];
+    else if(opt=="--mc" && a+1<argc)  // Monte Carlo PC scores
+      mctrials = atoi(argv[++a]);
+    else if(opt=="--sigmas" && a+1<argc)  // Metric uncertainties for --mc
+      sigmasname = argv[++a];
+    else if(opt=="--seed" && a+1<argc)
+      mcseed = strtoull(argv[++a],NULL,10);
+    else if(opt=="--sort")  // Input in any order
+      sortinput = true;
+    else if(opt=="--keyorder")  // With --sort, output sorted by KIC and planet number
+      keyorder = true;
+    else if(opt=="--cache")  // Keep a binary copy of each input file, INFILE.cache, and read that instead when it's up to date
+      usecache = true;
+    else if(opt=="--serve" && a+1<argc)  // Vetting service on a socket, or stdin and stdout
+      servename = argv[++a];
+    else if(opt=="--batch" && a+1<argc)  // Many input and output files, listed in a manifest
+      batchname = argv[++a];
+    else if(opt=="--ablate" && a+1<argc)  // Leave-one-out report on the tests
+      ablatename = argv[++a];
+    else if(opt=="--config" && a+1<argc)  // Thresholds from a file
+      configname = argv[++a];
+    else if(opt=="--set" && a+1<argc)  // One threshold, NAME=VALUE
+      sets.push_back(argv[++a]);
+    else if(opt=="--generic")  // No built in DR24 thresholds, for benchmarking
+      config.fastpath = false;
+    else if(opt=="--incremental" && a+1<argc)  // Only vet the systems that changed since the last run
+      statename = argv[++a];
+    else
+      args.push_back(opt);
+    }
+  if(nthreads<=0)
+    nthreads = max(1u,thread::hardware_concurrency());
+  if(configname!="")
+    READCONFIG(configname,config);
+  string err;
+  for(size_t k=0;k<sets.size();k++)
+    if(!SETTHRESH(sets[k],config,err))
+      {
+      cerr << "--set: " << err << endl;
+      exit(1);
+      }
+  config.update();
+  
+  if(servename!="")
+    {
+    if(!args.empty() || streaming || sweepfilename!="" || batchname!="" || checkephem || verify || ephemmatch || mctrials>0 || sortinput || statename!="" || binoutname!="" || statsname!="" || timing || ablatename!="")
+      {
+      cerr << "--serve only takes --config, --set and --generic" << endl;
+      exit(1);
+      }
+    SERVE();
+    return 0;
+    }
+  if(batchname!="")
+    {
+    if(!args.empty() || streaming || sweepfilename!="" || checkephem || verify || mctrials>0 || sortinput || statename!="" || binoutname!="" || statsname!="" || ablatename!="")
+      {
+      cerr << "--batch takes its files from the manifest, and can't be used with --stream, --sweep, --checkephem, --verify, --mc, --sort, --incremental, --binout, --stats or --ablate" << endl;
+      exit(1);
+      }
+    BATCH();
+    return 0;
+    }
+  
+  if(args.size()>0)
+    infilename = args[0];
+  else if(streaming)
+    infilename = "-";
   else
+    infilename = PROMPT("Name of intput file? ");
+    
+  if(args.size()>1)
+    outfilename = args[1];
+  else if(streaming)
+    outfilename = "-";
+  else if(!checkephem && !verify)
+    outfilename = PROMPT("Name of output file? ");
+  if(verify)  // The second file is the expected output, not one to write
     {
-    cout << "Name of output file? ";
-    cin >> outfilename;
+    expectname = outfilename;
+    outfilename = "";
     }
 
-    
-  READDATA();  // Read Input Data
   
-
-  // Figure out KIC, PN numbers, and total number of planets in each system, from TCE string
-  for(i=0;i<ntces;i++)
+  if(streaming && ephemmatch)
+    {
+    cerr << "--ephemmatch needs the whole catalog, so can't be used with --stream" << endl;
+    exit(1);
+    }
+  if(streaming && usecache)
+    {
+    cerr << "--cache can't be used with --stream" << endl;
+    exit(1);
+    }
+  if(mctrials>0 && (streaming || sweepfilename!=""))
+    {
+    cerr << "--mc can't be used with --stream or --sweep" << endl;
+    exit(1);
+    }
+  if(sortinput && (streaming || sweepfilename!=""))
+    {
+    cerr << "--sort can't be used with --stream or --sweep" << endl;
+    exit(1);
+    }
+  if(ablatename!="" && (streaming || sweepfilename!=""))
+    {
+    cerr << "--ablate can't be used with --stream or --sweep" << endl;
+    exit(1);
+    }
+  if(statename!="" && (streaming || sweepfilename!="" || mctrials>0))
+    {
+    cerr << "--incremental can't be used with --stream, --sweep or --mc" << endl;
+    exit(1);
+    }
+  if(verify && (streaming || sweepfilename!="" || checkephem || mctrials>0 || statename!="" || ablatename!="" || binoutname!="" || statsname!="" || timing))
+    {
+    cerr << "--verify only vets, and times itself, so can't be used with --stream, --sweep, --checkephem, --mc, --incremental, --ablate, --binout, --stats or --timing" << endl;
+    exit(1);
+    }
+  if((timing || statsname!="") && (streaming || sweepfilename!="" || checkephem))
+    {
+    cerr << "--timing and --stats can't be used with --stream, --sweep or --checkephem" << endl;
+    exit(1);
+    }
+  if(statsname!="" && !VETSTATS)
+    {
+    cerr << "--stats needs the counting that this robovet was built without (VETSTATS=0)" << endl;
+    exit(1);
+    }
+  if(mctrials>0 && sigmasname=="")
+    {
+    cerr << "--mc needs the uncertainties in --sigmas" << endl;
+    exit(1);
+    }
+  if(streaming)
+    {
+    STREAMVET(config);
+    return 0;
+    }
+  if(sweepfilename!="")
+    {
+    SWEEP();
+    return 0;
+    }
+  if(checkephem)
+    {
+    CHECKEPHEM();
+    return 0;
+    }
+  if(verify)
     {
-    if(data[i].kic != data[i-1].kic)  // If we're on a new system, figure out how many total planets in system for each TCE
-      for(j=1;j<=data[i-1].pn;j++)   // Update number of planets for all previous TCEs in the system
-        data[i-j].num_planets = data[i-1].pn; 
-    data[i].kic = stoi(data[i].tce.substr(1,9));   // KIC
-    data[i].pn  = stoi(data[i].tce.substr(11,2));  // Planet Number
+    VERIFY();
+    return 0;
     }
-  for(j=1;j<=data[i-1].pn;j++)
-    data[i-j].num_planets = data[i-1].pn;  // Update number of planets for the last system
     
-          
-  // Figure out the LPP threshold based on the number of TCEs
-  lppsig = sqrt(2)*INVERFC(1.0/20367);  // Fixing to OPS run number of 20,367 for both ops and injected so they use same thresholds
+  tcestore tces;
+  auto t0 = chrono::steady_clock::now();
+  LOADDATA(infilename,tces);  // Read Input Data
+  auto t1 = chrono::steady_clock::now();
+  if(sortinput)
+    {
+    vector<int> order;
+    SORTSYSTEMS(tces,order,nthreads);
+    if(!keyorder)  // Output line order[i] is row i
+      {
+      outrows.resize(order.size());
+      for(size_t i=0;i<order.size();i++)
+        outrows[order[i]] = i;
+      }
+    }
+  else
+    COUNTPLANETS(tces);
+  auto ts = chrono::steady_clock::now();
+  if(ephemmatch)
+    EPHEMMATCHFILES(tces,config);
 
-  
   // Okay let the judging begin!
-  outfile.open(outfilename.c_str());  // Open Outfile
-  outfile << "# 1:TCE  2:NExScI Disposition  3:Not Transit-Like Flag  4:Significant Secondary Flag  5:Centroid Offset Flag  6:Ephemeris Match Flag  7:Minor Descriptive Flags" << endl;
-  for(i=0;i<ntces;i++)
-    {      
-    data[i].comments="";  
-    not_transit_like[i]=sig_sec_eclipse[i]=planet_occultation[i]=period_is_double[i]=centroid_offset[i]=ephemeris_match[i]=0;  // Make sure all flags start at 0 - assumed PC until it fails a test
-    
-    // Let's keep track if we already found a seconary eclipse in the system or not
-    if(i==0 || data[i].kic!=data[i-1].kic || not_transit_like[i-1]==0)  // If it's the first TCE we're looking at, or if it's a new system, or if a transit-like TCE was found in the system since we last found a secondary, start looking for a secondary again.
-      secfound=0;
-    
-    // Check to see if TCE is a secondary eclipse
-    if(secfound==0)
-      ISSEC();
-    
-    // If not a secondary, check to see if TCE is Transit-Like
-    if(not_transit_like[i]==0 && sig_sec_eclipse[i]==0)
-      TRANSITLIKE();
-    
-    // Now if it is Transit-Like, check to see if there is a significant secondary eclipse
-    if(not_transit_like[i]==0 && sig_sec_eclipse[i]==0)
-      SECECLIPSE();
-    
-    // Apply robo centroid disposition
-    centroid_offset[i] = data[i].robo_cent_disp;
-    
-    // Apply ephem match disposition
-    ephemeris_match[i] = data[i].ephem_match_disp;
-      
-    // Make final PC/FP determination
-    nexscidisp="PC";
-    if(not_transit_like[i]==1)
-      nexscidisp="FP";
-    if(sig_sec_eclipse[i]==1 && planet_occultation[i]==0)  
-      nexscidisp="FP";
-    if(centroid_offset[i]==1)
-      nexscidisp="FP";
-    if(ephemeris_match[i]==1)
-      nexscidisp="FP";
-     
-    // Write output
-    outfile << data[i].tce << " " << nexscidisp << " " << not_transit_like[i] << " " << sig_sec_eclipse[i] << " " << centroid_offset[i] << " " << ephemeris_match[i] << " " << data[i].comments << endl;
+  flagstore fl;
+  vector<vetstats> stats;  // One per thread
+  if(statename!="")
+    INCREMENTALVET(tces,config,fl,statsname!="" ? &stats : nullptr);
+  else
+    VETALL(tces,config,fl,nthreads,statsname!="" ? &stats : nullptr);
+  if(mctrials>0)
+    {
+    mcsigmas sig;
+    READSIGMAS(sigmasname,sig);
+    MCSCORE(tces,config,sig,mctrials,mcseed,scores,nthreads);
     }
+  vector<uint64_t> flips;  // Tests whose removal changes each TCE's disposition, for --ablate
+  if(ablatename!="")
+    ABLATE(tces,config,fl,flips,nthreads);
+  auto t2 = chrono::steady_clock::now();
   
+  // Write output in input order, or with --keyorder in sorted order
+  outfile.open(outfilename.c_str());  // Open Outfile
+  WRITEHEADER(outfile);
+  WRITEOUTPUT(outfile,tces,fl,0,tces.size());
   outfile.close();
-  }
-  
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
+  if(binoutname!="")
+    {
+    binfile.open(binoutname.c_str(),ios::binary);
+    WRITEBINHEADER(binfile,tces.size());
+    WRITEBINARY(binfile,tces,fl,0,tces.size());
+    binfile.close();
+    }
+  if(ablatename!="")
+    {
+    ofstream ablatefile(ablatename.c_str());
+    WRITEABLATION(ablatefile,tces,fl,flips);
+    }
+  auto t3 = chrono::steady_clock::now();
   
-// Function to read in the data
-
-void READDATA()
-  {
-  infile.open(infilename.c_str());
-  if(infile.fail()==1) // If file doesn't exist, exit with warning
+  if(timing)
     {
-    cout << infilename << " doesn't exist or cannot open file..." << endl;
-    exit(0);
+    REPORTTIME("parse",t1-t0,tces.size());
+    if(sortinput)
+      REPORTTIME("sort",ts-t1,tces.size());
+    REPORTTIME("vet",t2-ts,tces.size());
+    REPORTTIME("write",t3-t2,tces.size());
+    REPORTTIME("total",t3-t0,tces.size());
     }
-    
-  infile.ignore(9E9,'\n');  // Ignore header
-  
-  i=0;
-  infile >> data[i].tce;
-  while(!infile.eof())
-    {
-    infile >> data[i].period;
-    infile >> data[i].epoch;
-    infile >> data[i].duration;
-    infile >> data[i].max_ses_in_mes;
-    infile >> data[i].mes;
-    infile >> data[i].lpp_tps;
-    infile >> data[i].lpp_trap;
-    infile >> data[i].marshall;
-    infile >> data[i].dv_oesig;
-    infile >> data[i].alt_oesig;
-    infile >> data[i].dv_sig_pri;
-    infile >> data[i].dv_sig_sec;
-    infile >> data[i].dv_sig_ter;
-    infile >> data[i].dv_sig_pos;
-    infile >> data[i].dv_fred;
-    infile >> data[i].dv_sig_fa;
-    infile >> data[i].dv_del_fa;
-    infile >> data[i].alt_sig_pri;
-    infile >> data[i].alt_sig_sec;
-    infile >> data[i].alt_sig_ter;
-    infile >> data[i].alt_sig_pos;
-    infile >> data[i].alt_fred;
-    infile >> data[i].alt_sig_fa;
-    infile >> data[i].alt_del_fa;
-    infile >> data[i].dv_rp;
-    data[i].alt_rp = data[i].dv_rp;
-    infile >> data[i].impact;
-    infile >> data[i].dv_alb;
-    infile >> data[i].dv_mod_pridepth;
-    infile >> data[i].dv_mod_secdepth;
-    infile >> data[i].dv_ph_sec;
-    infile >> data[i].alt_alb;
-    infile >> data[i].alt_mod_pridepth;
-    infile >> data[i].alt_mod_secdepth;
-    infile >> data[i].alt_ph_sec;
-    infile >> data[i].robo_cent_disp;
-    infile >> data[i].ephem_match_disp;
-    i++;
-    infile >> data[i].tce;
-    }
-  infile.close();
-  ntces=i;
-}
-
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
+  if(statsname!="")
+    {
+    const chrono::steady_clock::time_point t[] = {t0,t1,ts,t2,t3};
+    ofstream statsfile(statsname.c_str());
+    WRITESTATS(statsfile,stats,t);
+    }
+  }
 
-// Function to check if TCE is the secondary eclipse of the system
 
-void ISSEC() {
+// Ask for a filename that wasn't given. Only when someone is at the terminal, so scripts fail rather than hang.
 
-// If a previous TCE in the system had a sec eclipse detected, and this TCE has the same period / diff epoch as it, then this is the sec eclipse
-for(j=1;j<data[i].pn;j++)
+string PROMPT(const char *question)
   {
-  COMPPT(data[i].period,data[i-data[i].pn+j].period,data[i].epoch,data[i-data[i].pn+j].epoch);
-  tmpdob3 = data[i-data[i].pn+j].period/data[i].period;  // Modify the period ratio so that it's always the other TCE divided by the current one for this test. That way when tmpdob>=2, it always means the current TCE is half the period or less of the previous one.
-  
-  epochthresh = WIDTHFAC*data[i-data[i].pn+j].duration/24.0;
-
-  if(not_transit_like[i-data[i].pn+j]==0 && (sig_sec_eclipse[i-data[i].pn+j]==1 || period_is_double[i-data[i].pn+j]==1) && tmpdob1 > PSIG_THRESH && ((fabs(tmpdob4) > epochthresh) || (fabs(tmpdob4) < epochthresh && rint(tmpdob3)>=2 )) && ((fabs(tmpdob6) > epochthresh) || (fabs(tmpdob6) < epochthresh && rint(tmpdob3)>=2)) && ((tmpdob4<0 && tmpdob6<0) || (tmpdob4>0 && tmpdob6>0) || rint(tmpdob3)>=2) )  // Either same period and differnt epoch as a previous TCE, or half the period and same epoch. Both end up corresponding to the secondary eclipse.
+  if(!isatty(0))
     {
-    not_transit_like[i]=1;
-    sig_sec_eclipse[i]=1;
-    if(data[i].comments!="")  data[i].comments+="---";
-    data[i].comments+="THIS_TCE_IS_A_SEC";
-    j=99;  // Only need to trigger once
-    secfound=1;  // Note that we found a secondary for this system, so we don't search for more secondaries
+    cerr << "Usage: robovet [options] INFILE OUTFILE, or robovet [options] --batch MANIFEST" << endl;
+    exit(1);
     }
+  string name;
+  cout << question;
+  cin >> name;
+  return name;
   }
 
-}
 
+// Report how long a phase of the run took, to stderr
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
- 
-// Function to check if the TCE is not transit-like
- 
-void TRANSITLIKE() {
-  
-// DV LPP Test
-// if(data[i].lpp_tps > lppsig*0.000781) // && data[i].period < 50.0)  // Susan OLD value
-if(data[i].lpp_tps > 0.00104504238600969 + lppsig*0.000495720001967656)  // NEW value based on fitting gaussian to injections
+void REPORTTIME(const char *phase, chrono::steady_clock::duration elapsed, int nrows)
   {
-  not_transit_like[i]=1;
-  if(data[i].comments!="")  data[i].comments+="---";
-  data[i].comments+="LPP_DV_TOO_HIGH";
+  double secs = chrono::duration<double>(elapsed).count();
+  cerr << left << setw(6) << phase << right << fixed << setprecision(3) << setw(9) << secs << " s " << setw(14) << setprecision(0) << (secs>0 ? nrows/secs : 0.0) << " rows/s" << endl;
   }
 
 
-// Alt LPP Test
-// if(data[i].lpp_trap > lppsig*0.001001) // && data[i].period < 50.0)  // Susan OLD value
-if(data[i].lpp_trap > 0.000667164262937681 + lppsig*0.000417055294849554)  // NEW value based on fitting gaussian to injections
+// Write the --stats report, from the vetstats of each thread and the times t[0..4] at which parsing started and
+// parsing, sorting, vetting and writing finished. It is one JSON object:
+//
+//   rows, systems, threads      Counts of TCEs, KIC systems and threads
+//   seconds                     Wall clock time of parse, sort (0 without --sort), vet (including --ephemmatch
+//                               and --mc), write and total
+//   tests                       Per test function, the TCEs it ran on ("calls"), set its flag on ("fires"), and
+//                               the TCE pairs it compared ("pairs")
+//   flags                       Per minor flag, the TCEs its test was evaluated on and fired on, see vetstats
+//   pairs                       Pairs compared in all, the most in one system, and systems by pairs compared as
+//                               bins of "lo" to "hi" pairs, the last without "hi"
+//   per_thread                  Rows, systems, pairs and seconds spent vetting for each thread
+//
+// With --incremental, the counts only cover the systems that were vetted again.
+
+void WRITESTATS(ostream &out, const vector<vetstats> &stats, const chrono::steady_clock::time_point *t)
   {
-  not_transit_like[i]=1;
-  if(data[i].comments!="")  data[i].comments+="---";
-  data[i].comments+="LPP_ALT_TOO_HIGH";
-  }
+  vetstats all;
+  for(const vetstats &s : stats)
+    all.add(s);
+  auto secs = [&](int from, int to) {return chrono::duration<double>(t[to]-t[from]).count();};
   
-  
-// Check Marshall metric
-if(data[i].marshall > 10.0)
-  {
-  not_transit_like[i]=1;
-  if(data[i].comments!="")  data[i].comments+="---";
-  data[i].comments+="MARSHALL_FAIL";
+  out << fixed << setprecision(6);
+  out << "{\n  \"rows\": " << all.rows << ",\n  \"systems\": " << all.systems << ",\n  \"threads\": " << stats.size() << ",\n";
+  out << "  \"seconds\": {\"parse\": " << secs(0,1) << ", \"sort\": " << secs(1,2) << ", \"vet\": " << secs(2,3) << ", \"write\": " << secs(3,4) << ", \"total\": " << secs(0,4) << "},\n";
+  out << "  \"tests\": {";
+  for(int v=0;v<NVETTESTS;v++)
+    out << (v ? "," : "") << "\n    \"" << VETTESTNAMES[v] << "\": {\"calls\": " << all.calls[v] << ", \"fires\": " << all.fires[v] << ", \"pairs\": " << all.pairs[v] << "}";
+  out << "\n    },\n  \"flags\": {";
+  for(int f=0;f<NMINORFLAGS;f++)
+    out << (f ? "," : "") << "\n    \"" << MINORFLAGNAMES[f] << "\": {\"evaluated\": " << all.evaluated[f] << ", \"fired\": " << all.fired[f] << "}";
+  out << "\n    },\n  \"pairs\": {\"total\": " << all.totalpairs() << ", \"max_per_system\": " << all.maxpairs << ", \"systems_by_pairs\": [";
+  int nbins = NPAIRBINS;
+  while(nbins>1 && all.pairbins[nbins-1]==0)
+    nbins--;
+  for(int b=0;b<nbins;b++)
+    {
+    out << (b ? "," : "") << "\n    {\"lo\": " << (b ? 1ull<<(b-1) : 0);
+    if(b<NPAIRBINS-1)
+      out << ", \"hi\": " << (b ? (1ull<<b)-1 : 0);
+    out << ", \"systems\": " << all.pairbins[b] << "}";
+    }
+  out << "\n    ]},\n  \"per_thread\": [";
+  for(size_t th=0;th<stats.size();th++)
+    out << (th ? "," : "") << "\n    {\"rows\": " << stats[th].rows << ", \"systems\": " << stats[th].systems << ", \"pairs\": " << stats[th].totalpairs() << ", \"seconds\": " << stats[th].seconds << "}";
+  out << "\n    ]\n}\n";
   }
+  
 
+// Write the --ablate report, from the flags of the full vet and the flips of ABLATE. One line per test, the minor
+// flags in bit order followed by the centroid offset and ephemeris match dispositions:
+//
+//   Fired        TCEs the test fired on
+//   Only_fired   FPs on which no other test fired. This doesn't make it the reason for the FP, which FP_to_PC counts
+//   FP_to_PC     FPs that are PC without it
+//   PC_to_FP     PCs that are FP without it, as leaving out a test can turn another TCE of the system transit-like
+//   Knock_on     TCEs of either kind whose disposition changes without it, although it didn't fire on them
 
-// Check is primary is significant in DV 
-if(data[i].dv_sig_pri/data[i].dv_fred < data[i].dv_sig_fa && data[i].dv_sig_pri > 0)
-  {
-  not_transit_like[i]=1;
-  if(data[i].comments!="")  data[i].comments+="---";
-  data[i].comments+="DV_SIG_PRI_OVER_FRED_TOO_LOW";
-  }
-// Check is primary is significantly greater than tertiary in DV
-if(data[i].dv_sig_pri - data[i].dv_sig_ter < data[i].dv_del_fa && data[i].dv_sig_pri > 0 && data[i].dv_sig_ter > 0)  // 0 indicates NULL result
+void WRITEABLATION(ostream &out, const tcestore &tces, const flagstore &fl, const vector<uint64_t> &flips)
   {
-  not_transit_like[i]=1;
-  if(data[i].comments!="")  data[i].comments+="---";
-  data[i].comments+="DV_SIG_PRI_MINUS_SIG_TER_TOO_LOW";
+  vector<uint64_t> fired(tces.size());
+  int nfp = 0;
+  for(int i=0;i<tces.size();i++)
+    {
+    fired[i] = fl.minorflags[i] | (uint64_t)(fl.centroid_offset[i]!=0)<<ABLATE_CENTROID | (uint64_t)(fl.ephemeris_match[i]!=0)<<ABLATE_EPHEM;
+    nfp += ISFP(fl,i);
+    }
+  
+  out << "# " << tces.size() << " TCEs, " << nfp << " FP" << endl;
+  out << "# 1:Test  2:Fired  3:Only_fired  4:FP_to_PC  5:PC_to_FP  6:Knock_on" << endl;
+  for(int u=0;u<NABLATE;u++)
+    {
+    int nfired=0, only=0, topc=0, tofp=0, knock=0;
+    for(int i=0;i<tces.size();i++)
+      {
+      bool on = fired[i]>>u & 1, flip = flips[i]>>u & 1, fp = ISFP(fl,i);
+      nfired += on;
+      only += fp && fired[i]==1ull<<u;
+      topc += flip && fp;
+      tofp += flip && !fp;
+      knock += flip && !on;
+      }
+    out << (u<NMINORFLAGS ? MINORFLAGNAMES[u] : u==ABLATE_CENTROID ? "CENTROID_OFFSET" : "EPHEMERIS_MATCH") << " " << nfired << " " << only << " " << topc << " " << tofp << " " << knock << "\n";
+    }
   }
-// Check is primary is significantly greater than positive in DV
-if(data[i].dv_sig_pri - data[i].dv_sig_pos < data[i].dv_del_fa && data[i].dv_sig_pri > 0 && data[i].dv_sig_pos > 0)  // 0 indicates NULL result
+  
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to write the output header, and the output for rows first through last-1
+
+void WRITEHEADER(ostream &out)
   {
-  not_transit_like[i]=1;
-  if(data[i].comments!="")  data[i].comments+="---";
-  data[i].comments+="DV_SIG_PRI_MINUS_SIG_POS_TOO_LOW";
+  if(scores.empty())
+    out << "# 1:TCE  2:NExScI Disposition  3:Not Transit-Like Flag  4:Significant Secondary Flag  5:Centroid Offset Flag  6:Ephemeris Match Flag  7:Minor Descriptive Flags" << endl;
+  else
+    out << "# 1:TCE  2:NExScI Disposition  3:Not Transit-Like Flag  4:Significant Secondary Flag  5:Centroid Offset Flag  6:Ephemeris Match Flag  7:PC Score  8:Minor Descriptive Flags" << endl;
   }
-  
-  
-// Check if primary is significant in ALT
-if(data[i].alt_sig_pri/data[i].alt_fred < data[i].alt_sig_fa && data[i].alt_sig_pri > 0)
+
+// Spell out the minor flags as "---" separated names
+
+void WRITEFLAGS(string &buf, uint32_t flags)
   {
-  not_transit_like[i]=1;
-  if(data[i].comments!="")  data[i].comments+="---";
-  data[i].comments+="ALT_SIG_PRI_OVER_FRED_TOO_LOW";
+  bool first=true;
+  for(int f=0;flags!=0;f++,flags>>=1)
+    if(flags&1)
+      {
+      if(!first)
+        buf += "---";
+      buf += MINORFLAGNAMES[f];
+      first=false;
+      }
   }
-// Check is primary is significantly greater than tertiary in ALT
-if(data[i].alt_sig_pri - data[i].alt_sig_ter < data[i].alt_del_fa && data[i].alt_sig_pri > 0 && data[i].alt_sig_ter > 0)  // 0 indicates NULL result
+
+// Format output lines first through last-1 onto the end of buf. Line i is row i, or row outrows[i] if there is one.
+
+void FORMATROWS(string &buf, const tcestore &tces, const flagstore &fl, int first, int last)
   {
-  not_transit_like[i]=1;
-  if(data[i].comments!="")  data[i].comments+="---";
-  data[i].comments+="ALT_SIG_PRI_MINUS_SIG_TER_TOO_LOW";
+  char num[16];
+  for(int line=first;line<last;line++)
+    {
+    int i = outrows.empty() ? line : outrows[line];
+    buf += tces.tce[i];
+    buf += ISFP(fl,i) ? " FP " : " PC ";
+    const int cols[4] = {fl.not_transit_like[i],fl.sig_sec_eclipse[i],fl.centroid_offset[i],fl.ephemeris_match[i]};
+    for(int k=0;k<4;k++)
+      {
+      buf.append(num,to_chars(num,num+sizeof num,cols[k]).ptr);
+      buf += ' ';
+      }
+    if(!scores.empty())
+      {
+      buf.append(num,to_chars(num,num+sizeof num,scores[i],chars_format::general,6).ptr);
+      buf += ' ';
+      }
+    WRITEFLAGS(buf,fl.minorflags[i]);
+    buf += '\n';
+    }
   }
-// Check is primary is significantly greater than positive in ALT
-if(data[i].alt_sig_pri - data[i].alt_sig_pos < data[i].alt_del_fa && data[i].alt_sig_pri > 0 && data[i].alt_sig_pos > 0)  // 0 indicates NULL result
+
+
+// Function to write the header of a binary results file, followed by the minor flag names
+
+void WRITEBINHEADER(ostream &out, uint64_t nrows)
   {
-  not_transit_like[i]=1;
-  if(data[i].comments!="")  data[i].comments+="---";
-  data[i].comments+="ALT_SIG_PRI_MINUS_SIG_POS_TOO_LOW";
+  string names;
+  for(int f=0;f<NMINORFLAGS;f++)
+    names.append(MINORFLAGNAMES[f],strlen(MINORFLAGNAMES[f])+1);
+  names.resize((names.size()+7)/8*8);
+  binheader h = {{0},BINVERSION,sizeof(binresult),nrows,NMINORFLAGS,(uint32_t)names.size()};
+  memcpy(h.magic,"RVRESULT",8);
+  out.write((const char*)&h,sizeof h);
+  out.write(names.data(),names.size());
   }
 
+// Write the binary results for output lines first through last-1, in the same order as FORMATROWS
 
-// Check consistency of transits via SES to MES ratio
-if(data[i].max_ses_in_mes/data[i].mes > 0.9 && data[i].period > 90)  // Maybe 0.95?  0.99?   1.0 could work. 
+void WRITEBINARY(ostream &out, const tcestore &tces, const flagstore &fl, int first, int last)
   {
-  not_transit_like[i]=1;
-  if(data[i].comments!="")  data[i].comments+="---";
-  data[i].comments+="TRANSITS_NOT_CONSISTENT";
+  static vector<binresult> recs;
+  recs.resize(last-first);
+  for(int line=first;line<last;line++)
+    {
+    int i = outrows.empty() ? line : outrows[line];
+    binresult &r = recs[line-first];
+    r.kic = tces.kic[i];
+    r.pn = tces.pn[i];
+    r.fp = ISFP(fl,i);
+    r.flags = (fl.not_transit_like[i]!=0) | (fl.sig_sec_eclipse[i]!=0)<<1 | (fl.centroid_offset[i]!=0)<<2 | (fl.ephemeris_match[i]!=0)<<3;
+    r.minorflags = fl.minorflags[i];
+    }
+  out.write((const char*)recs.data(),recs.size()*sizeof(binresult));
   }
 
+// Rows are formatted in slices of OUTSLICE rows, a few slices per thread at a time, and each batch of slices is
+// written out in order. The buffers are kept from call to call.
 
-// If a previous TCE in the system has the same period as this one, and it was not transit-like, then this one should be too. Also check if previous TCE was transit-like, if this TCE is triggering off the residual of the earlier TCE.
-for(j=1;j<data[i].pn;j++)
+void WRITEOUTPUT(ostream &out, const tcestore &tces, const flagstore &fl, int first, int last)
   {
-  COMPPT(data[i].period,data[i-data[i].pn+j].period,data[i].epoch,data[i-data[i].pn+j].epoch);  // Compute diagnostics on the period and epoch matching
-  if(tmpdob1 > PSIG_THRESH)  // This TCE matches the period of a previous TCE in the system
+  const int OUTSLICE = 8192;
+  static vector<string> bufs;
+  int nslices = (last-first+OUTSLICE-1)/OUTSLICE;
+  int batch = 4*nthreads;
+  if((int)bufs.size()<min(nslices,batch))
+    bufs.resize(min(nslices,batch));
+  for(int s0=0;s0<nslices;s0+=batch)
     {
-    if(not_transit_like[i-data[i].pn+j]==1)  // If the previous TCE was deemed not transit-like, then this TCE should be not transit-like as well
+    int ns = min(batch,nslices-s0);
+    PARALLELFOR(ns,nthreads,1,[&](int a, int b)
       {
-      not_transit_like[i]=1;
-      if(data[i].comments!="")  data[i].comments+="---";
-      data[i].comments+="SAME_P_AS_PREV_NTL_TCE";
-      j=99;  // Only need to trigger once
-      }
-    else
-      if(fabs(tmpdob4) < WIDTHFAC*data[i-data[i].pn+j].duration/24.0 || fabs(tmpdob6) < WIDTHFAC*data[i-data[i].pn+j].duration/24.0 || (tmpdob4<0 && tmpdob6>0) || (tmpdob4>0 && tmpdob6<0))  // If previous TCE was transit-like, check to see if this TCE is triggering on its residuals, i.e., it's epoch is within two transit durations.
+      for(int k=a;k<b;k++)
         {
-        not_transit_like[i]=1;
-        if(data[i].comments!="")  data[i].comments+="---";
-        data[i].comments+="RESID_OF_PREV_TCE";
-        j=99;  // Only need to trigger once
+        bufs[k].clear();
+        FORMATROWS(bufs[k],tces,fl,first+(s0+k)*OUTSLICE,min(last,first+(s0+k+1)*OUTSLICE));
         }
+      });
+    for(int k=0;k<ns;k++)
+      out.write(bufs[k].data(),bufs[k].size());
     }
   }
-  
-}
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-
-// Function to check if the TCE has a visible secondary eclipse
   
-void SECECLIPSE() {
+// Function to read in the data. Returns the number of TCEs. Given err, a file that can't be read or a malformed row
+// is described there and -1 returned, rather than exiting.
 
-// Look for secondary in DV detrending  
-if(data[i].dv_sig_sec/data[i].dv_fred > data[i].dv_sig_fa && data[i].dv_sig_sec > 0)  // See if secondary is significant
-  if(data[i].dv_sig_sec - data[i].dv_sig_ter > data[i].dv_del_fa || data[i].dv_sig_ter <= 0)  // If ter measurement exists, check if sec is more significant
-    if(data[i].dv_sig_sec - data[i].dv_sig_pos > data[i].dv_del_fa || data[i].dv_sig_pos <= 0)  // If pos measurement exists, check if sec is more significant
+int READDATA(const string &infilename, tcestore &tces, string *err)
+  {
+  int fd = open(infilename.c_str(),O_RDONLY);
+  struct stat st;
+  if(fd<0 || fstat(fd,&st)!=0) // If file doesn't exist, exit with warning
+    {
+    if(fd>=0)
+      close(fd);
+    if(err!=nullptr)
       {
-      sig_sec_eclipse[i]=1;
-      if(data[i].comments!="")  data[i].comments+="---";
-      data[i].comments+="SIG_SEC_IN_DV_MODEL_SHIFT";
-      if(data[i].dv_alb > 0.0 && data[i].dv_alb < 1.0 && data[i].dv_rp > 0.0 && data[i].dv_rp < 30.0 && data[i].dv_mod_secdepth < 0.10*data[i].dv_mod_pridepth && data[i].impact < 0.95)  // Check to see if occultation could be due to planet. Only apply to things with less than 30 earth radii, and if the secodary is less than 10% the depth of the primary, and if impact parameter is less than 0.9.
-        {
-        planet_occultation[i]=1;
-        if(data[i].comments!="")  data[i].comments+="---";
-        data[i].comments+="DV_SEC_COULD_BE_DUE_TO_PLANET";
-        }
-      if(fabs(0.5 - data[i].dv_ph_sec)*data[i].period < 0.25*data[i].duration/24.0 && fabs(data[i].dv_sig_pri - data[i].dv_sig_sec) < data[i].dv_del_fa)  // Check to see if secondary could be identical to the transit so that it's really a PC phased at twice the period
-        {
-        period_is_double[i]=1;
-        if(data[i].comments!="")  data[i].comments+="---";
-        data[i].comments+="DV_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD";
-        }
+      *err = "doesn't exist or cannot open file";
+      return -1;
       }
-
-
-// Look for secondary in Alt detrending
-if(data[i].alt_sig_sec/data[i].alt_fred > data[i].alt_sig_fa && data[i].alt_sig_sec > 0)  // See if secondary is significant
-  if(data[i].alt_sig_sec - data[i].alt_sig_ter > data[i].alt_del_fa || data[i].alt_sig_ter <= 0)  // If ter measurement exists, check if sec is more significant
-    if(data[i].alt_sig_sec - data[i].alt_sig_pos > data[i].alt_del_fa || data[i].alt_sig_pos <= 0)  // If pos measurement exists, check if sec is more significant
+    cout << infilename << " doesn't exist or cannot open file..." << endl;
+    exit(0);
+    }
+  
+  // Map the whole file and tokenize it in place, rather than pulling each field through the locale-aware stream extractors
+  const char *buf = "";
+  if(st.st_size>0)
+    {
+    void *map = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    if(map==MAP_FAILED)
       {
-      sig_sec_eclipse[i]=1;
-      if(data[i].comments!="")  data[i].comments+="---";
-      data[i].comments+="SIG_SEC_IN_ALT_MODEL_SHIFT";
-      if(data[i].alt_alb > 0.0 && data[i].alt_alb < 1.0 && data[i].alt_rp > 0.0 && data[i].alt_rp < 30.0 && data[i].alt_mod_secdepth < 0.1*data[i].alt_mod_pridepth && data[i].impact < 0.95)  // Check to see if occultation could be due to planet
-        {
-        planet_occultation[i]=1;
-        if(data[i].comments!="")  data[i].comments+="---";
-        data[i].comments+="ALT_SEC_COULD_BE_DUE_TO_PLANET";
-        }
-      if(fabs(0.5 - data[i].alt_ph_sec)*data[i].period < 0.25*data[i].duration/24.0 && fabs(data[i].alt_sig_pri - data[i].alt_sig_sec) < data[i].alt_del_fa)  // Check to see if secondary could be identical to the transit so that it's really a PC phased at twice the period
+      close(fd);
+      if(err!=nullptr)
         {
-        period_is_double[i]=1;
-        if(data[i].comments!="")  data[i].comments+="---";
-        data[i].comments+="ALT_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD";
+        *err = "doesn't exist or cannot open file";
+        return -1;
         }
+      cout << infilename << " doesn't exist or cannot open file..." << endl;
+      exit(0);
+      }
+    madvise(map,st.st_size,MADV_SEQUENTIAL);
+    buf = (const char*)map;
+    }
+  const char *p = buf, *end = buf+st.st_size, *eol;
+  
+  // Size the columns from the line count up front so rows are parsed straight into place
+  int nlines=0;
+  for(eol=p; (eol=(const char*)memchr(eol,'\n',end-eol))!=NULL; eol++)
+    nlines++;
+  tces.resize(nlines+1);
+  
+  eol = (const char*)memchr(p,'\n',end-p);  // Ignore header
+  p = (eol==NULL) ? end : eol+1;
+  
+  int line=1;  // Line number in the input file, for error messages
+  int i=0;
+  while(p<end)
+    {
+    line++;
+    eol = (const char*)memchr(p,'\n',end-p);
+    if(eol==NULL)
+      eol = end;
+    
+    if(PARSEROW(tces,infilename,p,eol,line,i,err))
+      i++;
+    else if(err!=nullptr && !err->empty())
+      {
+      *err = "line " + to_string(line) + ": " + *err;
+      i = -1;
+      break;
       }
+    p = eol+1;
+    }
+  
+  if(st.st_size>0)
+    munmap((void*)buf,st.st_size);
+  close(fd);
+  tces.resize(max(i,0));
+  return i;
+}
+
+
+// Parse one input row, running from p up to the newline at eol, into row i of the columns. Returns false for a blank line.
+// A malformed row is an error as in PARSEERROR, or given err, is described there and also returns false.
+
+bool PARSEROW(tcestore &tces, const string &filename, const char *p, const char *eol, int line, int i, string *err)
+  {
+  const char *tok;
+  int k;
+  p = SKIPSPACE(p,eol);
+  if(p==eol)  // Skip blank lines
+    return false;
+  
+  // TCE string, decoded straight into KIC and planet number
+  for(tok=p; p<eol && !ISSPACE(*p); p++);
+  tces.tce[i].assign(tok,p-tok);
+  if(!DECODETCE(tok,p,tces.kic[i],tces.pn[i]))
+    return ROWERROR(filename,line,"cannot decode TCE id '" + tces.tce[i] + "', expected KIC-PN",err);
+  
+  // Metric columns, in file order
+  for(k=0;k<NINCOLS;k++)
+    {
+    p = SKIPSPACE(p,eol);
+    if(p==eol)
+      return ROWERROR(filename,line,"expected " + to_string(NINCOLS+3) + " columns, found " + to_string(k+1),err);
+    p = PARSENUM(p,eol,(tces.*INCOLS[k])[i]);
+    if(p==NULL)
+      return ROWERROR(filename,line,"bad number in column " + to_string(k+2),err);
+    }
+  tces.alt_rp[i] = tces.dv_rp[i];
+  
+  // Centroid and ephemeris match dispositions
+  for(k=0;k<2;k++)
+    {
+    p = SKIPSPACE(p,eol);
+    if(p==eol)
+      return ROWERROR(filename,line,"expected " + to_string(NINCOLS+3) + " columns, found " + to_string(NINCOLS+k+1),err);
+    p = PARSENUM(p,eol,(k==0 ? tces.robo_cent_disp[i] : tces.ephem_match_disp[i]));
+    if(p==NULL)
+      return ROWERROR(filename,line,"bad integer in column " + to_string(NINCOLS+k+2),err);
+    }
+  
+  if(SKIPSPACE(p,eol)!=eol)
+    return ROWERROR(filename,line,"more than " + to_string(NINCOLS+3) + " columns",err);
+  
+  return true;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to read in the data, from the binary cache INFILE.cache with --cache. The cache is made by the first run
+// that finds it missing or out of date, and later runs map it straight into the columns rather than parsing the text.
+// Returns the number of TCEs, or -1 with err set as in READDATA.
 
+int LOADDATA(const string &filename, tcestore &tces, string *err)
+  {
+  uint64_t src[4];
+  if(!usecache || !SRCSTAT(filename,src))  // A missing input is reported by READDATA
+    return READDATA(filename,tces,err);
+  string cachename = filename + ".cache";
+  if(READCACHE(cachename,src,tces))
+    return tces.size();
+  if(READDATA(filename,tces,err)<0)
+    return -1;
+  WRITECACHE(cachename,src,tces);
+  return tces.size();
+  }
+
+
+// Get what identifies a version of the input: size, modification time and inode. A rewrite of the input changes at least one.
 
-//  Odd-Even Test from DV detrending
-if(data[i].period < 90.0 && data[i].dv_oesig > 1.70)
+bool SRCSTAT(const string &filename, uint64_t *src)
   {
-  sig_sec_eclipse[i]=1;
-  if(data[i].comments!="")  data[i].comments+="---";
-  data[i].comments+="DV_ROBO_ODD_EVEN_TEST_FAIL";
+  struct stat st;
+  if(stat(filename.c_str(),&st)!=0)
+    return false;
+  src[0] = st.st_size;
+  src[1] = st.st_mtim.tv_sec;
+  src[2] = st.st_mtim.tv_nsec;
+  src[3] = st.st_ino;
+  return true;
   }
 
-//  Odd-Even Test from Chris detrending
-if(data[i].period < 90.0 && data[i].alt_oesig > 1.70)
+
+// Work out where each section of a cache file goes for nrows rows with nchars characters of TCE strings. Fills in the
+// offset of each column, then the string offsets, then the characters, and returns the size of the file.
+
+uint64_t CACHELAYOUT(uint64_t nrows, uint64_t nchars, vector<uint64_t> &offsets)
   {
-  sig_sec_eclipse[i]=1;
-  if(data[i].comments!="")  data[i].comments+="---";
-  data[i].comments+="ALT_ROBO_ODD_EVEN_TEST_FAIL";
+  auto align = [](uint64_t x) {return (x+CACHEALIGN-1)/CACHEALIGN*CACHEALIGN;};
+  uint64_t at = align(sizeof(cacheheader));
+  offsets.clear();
+#define X(col) offsets.push_back(at); at = align(at + nrows*sizeof(int));
+  TCE_INT_COLUMNS(X)
+#undef X
+#define X(col) offsets.push_back(at); at = align(at + nrows*sizeof(double));
+  TCE_DOUBLE_COLUMNS(X)
+#undef X
+  offsets.push_back(at);
+  at = align(at + (nrows+1)*sizeof(uint64_t));
+  offsets.push_back(at);
+  return align(at + nchars);
   }
 
 
-// Check if subsequent TCE has same period, indicating a secondary eclipse
-if(data[i].kic == data[i+1].kic) // Only run this test if there are subsequent TCEs belonging to the same KIC. Mostly just a precaution for injection systems.
-  for(j=1;j<=data[i].num_planets-data[i].pn;j++)  // Start looking at the next TCE in the system, and every subsequent TCE, through the last TCE in the system
+// Function to map a cache file into tces, if it was made from the input identified by src and is intact. The mapping
+// is private and writable, so the columns can be changed like any others, and stays in place until the program ends.
+
+bool READCACHE(const string &cachename, const uint64_t *src, tcestore &tces)
+  {
+  int fd = open(cachename.c_str(),O_RDONLY);
+  struct stat st;
+  if(fd<0)
+    return false;
+  if(fstat(fd,&st)!=0 || st.st_size<(off_t)sizeof(cacheheader))
     {
-    COMPPT(data[i].period,data[i+j].period,data[i].epoch,data[i+j].epoch);
-    if(tmpdob1 > PSIG_THRESH && (fabs(tmpdob4) > WIDTHFAC*data[i].duration/24.0 || (fabs(tmpdob4) < WIDTHFAC*data[i].duration/24.0 && rint(tmpdob3)>=2 )) && (fabs(tmpdob6) > WIDTHFAC*data[i].duration/24.0 || (fabs(tmpdob6) < WIDTHFAC*data[i].duration/24.0 && rint(tmpdob3)>=2)) && ((tmpdob4<0 && tmpdob6<0) || (tmpdob4>0 && tmpdob6>0) || rint(tmpdob3)>=2))  // Significant period match, at least 2 transit durations away, and either an insigniicant epoch match or more than a day apart. Put in condition so that if close periods, but some drift, will look for drift across the primary transit
-      {
-      sig_sec_eclipse[i]=1;
-      if(data[i].comments!="")  data[i].comments+="---";
-      data[i].comments+="OTHER_TCE_AT_SAME_PERIOD_DIFF_EPOCH";
-      j=99;  // Only need to trigger this once
-      }
+    close(fd);
+    return false;
+    }
+  char *buf = (char*)mmap(NULL,st.st_size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_POPULATE,fd,0);
+  close(fd);
+  if(buf==MAP_FAILED)
+    return false;
+  
+  // Check it belongs to this input and this build, then that it's all there
+  cacheheader h;
+  memcpy(&h,buf,sizeof h);
+  vector<uint64_t> offsets;
+  bool ok = memcmp(h.magic,"RVCACHE",8)==0 && h.version==CACHEVERSION && h.layout==LAYOUTHASH() && h.size==(uint64_t)st.st_size && memcmp(h.src,src,sizeof h.src)==0 && h.nrows<(uint64_t)st.st_size;
+  if(ok)
+    {
+    uint64_t nchars = 0;
+    ok = CACHELAYOUT(h.nrows,0,offsets)<=h.size;
+    if(ok)
+      memcpy(&nchars,buf+offsets[offsets.size()-2]+h.nrows*sizeof(uint64_t),sizeof nchars);  // Last string offset
+    ok = ok && CACHELAYOUT(h.nrows,nchars,offsets)==h.size && CHECKSUM(buf+offsets[0],h.size-offsets[0])==h.checksum;
+    }
+  if(!ok)
+    {
+    munmap(buf,st.st_size);
+    return false;
     }
+  
+  int n = h.nrows, c = 0;
+  tces.resize(0);
+#define X(col) tces.col.view((int*)(buf+offsets[c++]),n);
+  TCE_INT_COLUMNS(X)
+#undef X
+#define X(col) tces.col.view((double*)(buf+offsets[c++]),n);
+  TCE_DOUBLE_COLUMNS(X)
+#undef X
+  const uint64_t *stroff = (const uint64_t*)(buf+offsets[c]);
+  const char *chars = buf+offsets[c+1];
+  tces.tce.resize(n);
+  for(int i=0;i<n;i++)
+    tces.tce[i].assign(chars+stroff[i],stroff[i+1]-stroff[i]);
+  return true;
+  }
 
 
-// Now if a secondary was detected, but the period could be double the true period, mark it as not actually having a secondary
-if(period_is_double[i]==1)
-  sig_sec_eclipse[i]=0;
-}
+// Function to write tces to a cache file for the input identified by src. The file is built under a temporary name
+// and renamed into place, so other runs never see half of it. Failing to write it is only worth a warning.
+
+void WRITECACHE(const string &cachename, const uint64_t *src, const tcestore &tces)
+  {
+  int n = tces.size();
+  vector<uint64_t> offsets;
+  uint64_t nchars = 0;
+  for(int i=0;i<n;i++)
+    nchars += tces.tce[i].size();
+  uint64_t size = CACHELAYOUT(n,nchars,offsets);
+  
+  static atomic<int> ntmp{0};  // --batch can list the same input twice, so threads of one process need their own names too
+  string tmpname = cachename + ".tmp" + to_string(getpid()) + "." + to_string(ntmp++);
+  int fd = open(tmpname.c_str(),O_RDWR|O_CREAT|O_TRUNC,0644);
+  char *buf = (char*)MAP_FAILED;
+  if(fd>=0 && ftruncate(fd,size)==0)
+    buf = (char*)mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+  if(buf==MAP_FAILED)
+    {
+    cerr << "Warning: cannot write " << cachename << endl;
+    if(fd>=0)
+      {
+      close(fd);
+      unlink(tmpname.c_str());
+      }
+    return;
+    }
+  
+  int c = 0;
+#define X(col) memcpy(buf+offsets[c++],&tces.col[0],n*sizeof(int));
+  TCE_INT_COLUMNS(X)
+#undef X
+#define X(col) memcpy(buf+offsets[c++],&tces.col[0],n*sizeof(double));
+  TCE_DOUBLE_COLUMNS(X)
+#undef X
+  uint64_t *stroff = (uint64_t*)(buf+offsets[c]);
+  char *chars = buf+offsets[c+1];
+  stroff[0] = 0;
+  for(int i=0;i<n;i++)
+    {
+    memcpy(chars+stroff[i],tces.tce[i].data(),tces.tce[i].size());
+    stroff[i+1] = stroff[i] + tces.tce[i].size();
+    }
   
+  cacheheader h = {"RVCACHE",CACHEVERSION,LAYOUTHASH(),(uint64_t)n,{src[0],src[1],src[2],src[3]},size,CHECKSUM(buf+offsets[0],size-offsets[0])};
+  memcpy(buf,&h,sizeof h);
+  munmap(buf,size);
+  close(fd);
+  if(rename(tmpname.c_str(),cachename.c_str())!=0)
+    {
+    cerr << "Warning: cannot write " << cachename << endl;
+    unlink(tmpname.c_str());
+    }
+  }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
 
-// Function to compute the match significance of two periods and epochs
+// Function to hash len bytes at p, a multiple of 32, for the cache checksum. Four independent lanes keep it at memory speed.
 
-void COMPPT(double P1, double P2, double T1, double T2) {
-  
-if(P1 < P2)
+uint64_t CHECKSUM(const char *p, size_t len)
   {
-  tmpdob1 = PSIG(P1,P2);  // Period match significance
-  tmpdob2 = ESIG(T1,T2,P1);  // Epoch match significance
-  tmpdob3 = P2/P1;  // Period Ratio
-  tmpdob4 = T1 - T2;  // Difference in epoch
-  while(tmpdob4 > 0.5*P1)
-    tmpdob4 -= P1;
-  while(tmpdob4 < -0.5*P1)
-    tmpdob4 += P1;
-  tmpdob6 = tmpdob4 + int(MISSIONDUR/P2)*(rint(tmpdob3)*P1-P2);  // Difference in epoch by end of mission
-
+  const uint64_t K = 0x9E3779B97F4A7C15ull;
+  uint64_t h[4] = {1,2,3,4};
+  auto mix = [&](uint64_t &x, uint64_t w) {x = (x^w)*K; x ^= x>>29;};
+  for(size_t b=0;b<len;b+=32)
+    for(int k=0;k<4;k++)
+      {
+      uint64_t w;
+      memcpy(&w,p+b+8*k,sizeof w);
+      mix(h[k],w);
+      }
+  uint64_t sum = len;
+  for(int k=0;k<4;k++)
+    mix(sum,h[k]);
+  return sum;
   }
-else
+
+
+// Hash of the names and types of the cached columns
+
+uint64_t LAYOUTHASH()
   {
-  tmpdob1 = PSIG(P2,P1);  // Period match significance
-  tmpdob2 = ESIG(T2,T1,P2);  // Epoch match significance
-  tmpdob3 = P1/P2;  // Period Ratio
-  tmpdob4 = T2 - T1;  // Difference in epoch
-  while(tmpdob4 > 0.5*P2)
-    tmpdob4 -= P2;
-  while(tmpdob4 < -0.5*P2)
-    tmpdob4 += P2;
-  tmpdob6 = tmpdob4 + int(MISSIONDUR/P1)*(rint(tmpdob3)*P2-P1);  // Difference in epoch by end of mission
+  string layout;
+#define X(col) layout += " int " #col;
+  TCE_INT_COLUMNS(X)
+#undef X
+#define X(col) layout += " double " #col;
+  TCE_DOUBLE_COLUMNS(X)
+#undef X
+  layout.resize((layout.size()+31)/32*32);
+  return CHECKSUM(layout.data(),layout.size());
   }
 
-}
 
-double PSIG(double P1, double P2) {
-  return sqrt(2)*INVERFC(fabs((P1-P2)/P1 - rint((P1-P2)/P1)));
-}
+// Hash of the thresholds and of the names of the minor flags, so a state file is only used with the same vetting
 
-double ESIG(double E1, double E2, double P) {
-  return sqrt(2)*INVERFC(fabs((E1-E2)/P - rint((E1-E2)/P)));
-}
+uint64_t CONFIGHASH(const vetconfig &cfg)
+  {
+  string config;
+  for(int k=0;k<NTHRESH;k++)
+    {
+    double val = cfg.*THRESHFIELDS[k];
+    config += THRESHNAMES[k];
+    config.append((const char*)&val,sizeof val);
+    }
+  config.append((const char*)&cfg.pfrac_lo,sizeof cfg.pfrac_lo);
+  config.append((const char*)&cfg.pfrac_hi,sizeof cfg.pfrac_hi);
+  config.append((const char*)&cfg.lppsig,sizeof cfg.lppsig);
+  for(int f=0;f<NMINORFLAGS;f++)
+    config += MINORFLAGNAMES[f];
+  config.resize((config.size()+31)/32*32);
+  return CHECKSUM(config.data(),config.size());
+  }
 
 
-///////////////////////////////////////////////////////////////////////////////////////////////////
+// Hash of every column of the input, for --incremental to tell that nothing at all has changed without hashing each
+// group. Each column is read straight through by CHECKSUM, which is quicker than vetting.
+
+uint64_t INPUTHASH(const tcestore &tces)
+  {
+  vector<pair<const char*,size_t> > cols;
+#define X(col) cols.push_back(make_pair((const char*)&tces.col[0],tces.size()*sizeof tces.col[0]));
+  TCE_INT_COLUMNS(X)
+  TCE_DOUBLE_COLUMNS(X)
+#undef X
+  vector<uint64_t> sums((cols.size()+3)/4*4,0);  // One per column, in whole 32 byte blocks for CHECKSUM
+  PARALLELFOR(cols.size(),nthreads,1,[&](int first, int last)
+    {
+    for(int c=first;c<last;c++)
+      {
+      size_t whole = cols[c].second/32*32;
+      char tail[64] = {0};  // The bytes after the last whole block, then the checksum of the whole blocks
+      if(cols[c].second>whole)
+        memcpy(tail,cols[c].first+whole,cols[c].second-whole);
+      uint64_t sum = CHECKSUM(cols[c].first,whole);
+      memcpy(tail+32,&sum,sizeof sum);
+      sums[c] = CHECKSUM(tail,sizeof tail);
+      }
+    });
+  return CHECKSUM((const char*)sums.data(),sums.size()*sizeof(uint64_t));
+  }
+
 
-// The error function 
+// Bytes of an --incremental state file after the header, for ngroups groups and nrows rows
 
-double INVERFC(double p) {
-  double x, err, t, pp;
+uint64_t STATESIZE(uint64_t ngroups, uint64_t nrows)
+  {
+  return (ngroups*sizeof(stategroup) + nrows*sizeof(stateresult) + 31)/32*32;
+  }
 
-  if (p >= 2.) return -100.;
-  if (p <= 0.0) return 100.;
 
-  pp=(p < 1.0)? p:2.-p;
-  t=sqrt(-2.*log(pp/2));
+///////////////////////////////////////////////////////////////////////////////////////////////////
 
-  x= -0.70711*((2.30753+t*0.27061)/(1+t*(0.99229+t*0.04481))-t);
+// Function to vet with --incremental. Each group of rows (see FINDGROUPS) is a KIC system, or with unsorted
+// injection input the few systems a lone TCE's comparisons run back over. When the input is the one the state file
+// was written for (see INPUTHASH), every row takes its flags from there and nothing else is done. Otherwise a group
+// whose hash (see HASHGROUPS) is in the state file takes its flags from there, the rest are vetted with VETGROUPS,
+// and the state file is rewritten for this input. A missing, damaged or out of date state file just means every
+// group is vetted.
 
-  for (int j=0;j<2;j++) {
-    err=erfc(x)-pp;
-    x += err/(1.12837916709551257*exp(-x*x)-x*err);
-  }
-  return (p<1.0 ? x:-x);
-}
+void INCREMENTALVET(const tcestore &tces, const vetconfig &cfg, flagstore &fl, vector<vetstats> *stats)
+  {
+  int n = tces.size();
+  uint64_t config = CONFIGHASH(cfg), input = INPUTHASH(tces);
+  fl.resize(n);
+  auto getresults = [&](const stateresult *r, int first, int len)
+    {
+    for(int k=0;k<len;k++)
+      {
+      int i = first+k;
+      fl.not_transit_like[i] = r[k].flags & 1;
+      fl.sig_sec_eclipse[i] = r[k].flags>>1 & 1;
+      fl.planet_occultation[i] = r[k].flags>>2 & 1;
+      fl.centroid_offset[i] = r[k].flags>>3 & 1;
+      fl.period_is_double[i] = r[k].flags>>4 & 1;
+      fl.ephemeris_match[i] = r[k].flags>>5 & 1;
+      fl.minorflags[i] = r[k].minorflags;
+      }
+    };
+  
+  // Map the last run's results. The counts in the header are checked against the size of the file before anything
+  // is read, and the rest against the checksum, so a damaged file is only a file that doesn't match.
+  stateheader h;
+  const stategroup *oldgroups = nullptr;
+  const stateresult *oldres = nullptr;
+  size_t noldgroups = 0;
+  char *map = (char*)MAP_FAILED;
+  struct stat st;
+  int fd = open(statename.c_str(),O_RDONLY);
+  if(fd>=0 && fstat(fd,&st)==0 && st.st_size>=(off_t)sizeof(stateheader))
+    map = (char*)mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE|MAP_POPULATE,fd,0);
+  if(fd>=0)
+    close(fd);
+  if(map!=MAP_FAILED)
+    {
+    memcpy(&h,map,sizeof h);
+    uint64_t body = st.st_size - sizeof h;
+    if(memcmp(h.magic,"RVSTATE",8)==0 && h.version==STATEVERSION && h.layout==LAYOUTHASH() && h.config==config && h.ngroups<=h.nrows &&
+       h.nrows<=body/sizeof(stateresult) && STATESIZE(h.ngroups,h.nrows)==body && CHECKSUM(map+sizeof h,body)==h.checksum)
+      {
+      oldgroups = (const stategroup*)(map+sizeof h);
+      oldres = (const stateresult*)(oldgroups+h.ngroups);
+      noldgroups = h.ngroups;
+      for(size_t j=0;j<noldgroups;j++)
+        if(oldgroups[j].first>h.nrows || oldgroups[j].nrows>h.nrows-oldgroups[j].first)
+          {
+          noldgroups = 0;
+          break;
+          }
+      }
+    }
+  
+  // The same input as last time, so the same results, and the state file already holds them
+  if(noldgroups>0 && h.input==input && h.nrows==(uint64_t)n)
+    {
+    getresults(oldres,0,n);
+    munmap(map,st.st_size);
+    if(timing)
+      cerr << "vetted 0 of " << noldgroups << " systems, 0 of " << n << " rows" << endl;
+    return;
+    }
+  
+  // Copy through the groups that haven't changed, and vet the rest. Most groups are where they were last time, so
+  // they're looked for just after the last one found. A group changed in place leaves the one after it where it
+  // was, so that is checked next, and only otherwise are the old hashes sorted with RADIXSORT to look it up.
+  vector<int> groupstart = FINDGROUPS(tces);
+  int ngroups = groupstart.size()-1;
+  vector<uint64_t> hash = HASHGROUPS(tces,groupstart,nthreads);
+  vector<char> need(ngroups);
+  vector<uint64_t> oldhash;
+  vector<int> sorted;
+  size_t next = 0;
+  for(int g=0;g<ngroups;g++)
+    {
+    int first = groupstart[g], len = groupstart[g+1]-first;
+    if(next>=noldgroups || oldgroups[next].hash!=hash[g])
+      {
+      if(g+1<ngroups && next+1<noldgroups && oldgroups[next+1].hash==hash[g+1])
+        {
+        need[g] = 1;
+        next++;
+        continue;
+        }
+      if(sorted.empty() && noldgroups>0)
+        {
+        for(size_t j=0;j<noldgroups;j++)
+          oldhash.push_back(oldgroups[j].hash);
+        sorted = RADIXSORT(oldhash,nthreads);
+        }
+      auto it = lower_bound(sorted.begin(),sorted.end(),hash[g],[&](int j, uint64_t v) {return oldhash[j]<v;});
+      next = (it!=sorted.end() && oldhash[*it]==hash[g]) ? *it : noldgroups;
+      }
+    if(next>=noldgroups || oldgroups[next].nrows!=(uint64_t)len)
+      need[g] = 1;
+    else
+      getresults(&oldres[oldgroups[next++].first],first,len);
+    }
+  if(map!=MAP_FAILED)
+    munmap(map,st.st_size);
+  VETGROUPS(tces,cfg,fl,groupstart,need,nthreads,stats);
+  
+  // Write the new state under a temporary name and rename it into place
+  vector<char> body(STATESIZE(ngroups,n),0);
+  stategroup *groups = (stategroup*)body.data();
+  stateresult *res = (stateresult*)(groups+ngroups);
+  for(int g=0;g<ngroups;g++)
+    groups[g] = {hash[g],(uint64_t)groupstart[g],(uint64_t)(groupstart[g+1]-groupstart[g])};
+  for(int i=0;i<n;i++)
+    {
+    res[i].flags = (fl.not_transit_like[i]!=0) | (fl.sig_sec_eclipse[i]!=0)<<1 | (fl.planet_occultation[i]!=0)<<2 | (fl.centroid_offset[i]!=0)<<3 | (fl.period_is_double[i]!=0)<<4 | (fl.ephemeris_match[i]!=0)<<5;
+    res[i].minorflags = fl.minorflags[i];
+    }
+  stateheader nh = {{0},STATEVERSION,LAYOUTHASH(),config,input,(uint64_t)ngroups,(uint64_t)n,CHECKSUM(body.data(),body.size())};
+  memcpy(nh.magic,"RVSTATE",8);
+  string tmpname = statename + ".tmp" + to_string(getpid());
+  ofstream out(tmpname.c_str(),ios::binary);
+  out.write((const char*)&nh,sizeof nh);
+  out.write(body.data(),body.size());
+  out.close();
+  if(!out || rename(tmpname.c_str(),statename.c_str())!=0)
+    {
+    cerr << "Warning: cannot write " << statename << endl;
+    unlink(tmpname.c_str());
+    }
+  
+  if(timing)
+    {
+    int nvet = 0, rvet = 0;
+    for(int g=0;g<ngroups;g++)
+      if(need[g])
+        {
+        nvet++;
+        rvet += groupstart[g+1]-groupstart[g];
+        }
+    cerr << "vetted " << nvet << " of " << ngroups << " systems, " << rvet << " of " << n << " rows" << endl;
+    }
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to read, vet and write the input a few KIC systems at a time, so memory use doesn't grow with the catalog
+// and results come out by the end of each read. Input and output may be pipes. Rows are held until they
+// end a group, as in FINDGROUPS, and at least maxpn-1 rows have been read after them, maxpn being the largest planet
+// number so far. A later row then can't look back at them unless its planet number is larger still, and every row SECECLIPSE
+// compares them with has been read, so the results are the same as a full run. A row that does look back at rows
+// already written is reported, as its results and theirs may differ from a full run.
+
+void STREAMVET(const vetconfig &cfg)
+  {
+  const int STREAMBLOCK = 256;  // Rows to hold before writing, so the vetting isn't done a system at a time
+  int fd = (infilename=="-") ? 0 : open(infilename.c_str(),O_RDONLY);
+  if(fd<0) // If file doesn't exist, exit with warning
+    {
+    cerr << infilename << " doesn't exist or cannot open file..." << endl;
+    exit(1);
+    }
+  if(outfilename!="-")
+    outfile.open(outfilename.c_str());
+  ostream &out = (outfilename=="-") ? cout : outfile;
+  streamoff binstart = 0;  // Where the binary results start, after the header
+  if(binoutname!="")
+    {
+    binfile.open(binoutname.c_str(),ios::binary);
+    WRITEBINHEADER(binfile,0);  // The number of rows is filled in at the end
+    binstart = binfile.tellp();
+    }
+  
+  tcestore tces,next;  // Rows not yet written, and the row just read
+  flagstore fl;
+  next.resize(1);
+  vector<char> buf(1<<20);
+  size_t have=0;  // Bytes in buf not yet parsed
+  int line=0, n=0, maxpn=1;  // Line number in the input, rows held in tces, largest planet number so far
+  long nwritten=0, nreach=0;  // Rows written, and rows that looked back at some of them
+  bool done=false;
+  WRITEHEADER(out);
+  
+  // Write the rows that no later row can change, up to the last group end that has maxpn-1 rows after it. At the
+  // start of a new system, the rows held are a whole number of systems, so they can all end a group.
+  auto writeready = [&](bool atsystem)
+    {
+    int reach=n, b=0;  // Earliest row looked back at from row i on, and the rows to write
+    for(int i=n;i>0 && b==0;i--)
+      {
+      if(i<n)
+        {
+        reach = min(reach,BEHIND(tces,i));
+        if(tces.kic[i]==tces.kic[i-1])
+          continue;
+        }
+      else if(!atsystem)
+        continue;
+      if(reach>=i && n-i>=maxpn-1)
+        b = i;
+      }
+    if(b==0)
+      return;
+    VETSYSTEM(out,tces,fl,cfg,b);
+    for(int k=b;k<n;k++)
+      tces.copyrow(tces,k,k-b);
+    n -= b;
+    nwritten += b;
+    };
+  while(!done)
+    {
+    ssize_t got = read(fd,buf.data()+have,buf.size()-have);
+    if(got<0)
+      {
+      cerr << infilename << ": read error" << endl;
+      exit(1);
+      }
+    have += got;
+    done = (got==0);
+    
+    // Parse every complete line in the buffer, plus an unterminated last line at EOF
+    const char *p = buf.data(), *end = buf.data()+have, *eol;
+    while(p<end)
+      {
+      eol = (const char*)memchr(p,'\n',end-p);
+      if(eol==NULL && !done)
+        break;
+      if(eol==NULL)
+        eol = end;
+      line++;
+      if(line>1)  // Ignore header
+        {
+        if(PARSEROW(next,infilename,p,eol,line,0))
+          {
+          maxpn = max(maxpn,next.pn[0]);
+          if(n>=STREAMBLOCK && next.kic[0]!=tces.kic[n-1])  // First row of the next system
+            writeready(true);
+          if(nwritten>0 && n-max(next.pn[0],1)+1<0 && nreach++==0)
+            cerr << "Warning: " << infilename << ":" << line << ": " << next.tce[0] << " looks back at rows already written" << endl;
+          tces.resize(n+1);  // Columns keep their capacity, so this only allocates while systems keep getting bigger
+          tces.copyrow(next,0,n);
+          n++;
+          }
+        }
+      p = (eol==end) ? end : eol+1;
+      }
+    
+    // Keep the partial line for the next read, making room if one line fills the whole buffer
+    have = end-p;
+    memmove(buf.data(),p,have);
+    if(have==buf.size())
+      buf.resize(2*buf.size());
+    writeready(false);
+    out.flush();  // Results for every system complete so far go out now, rather than waiting on the stream buffer
+    }
+  if(n>0)
+    VETSYSTEM(out,tces,fl,cfg,n);
+  if(nreach>0)
+    cerr << "Warning: " << nreach << " rows looked back at rows already written, so some results may differ from a run without --stream" << endl;
+  
+  if(fd!=0)
+    close(fd);
+  if(binoutname!="")
+    {
+    streamoff size = binfile.tellp();
+    binfile.seekp(0);
+    WRITEBINHEADER(binfile,(size-binstart)/sizeof(binresult));
+    binfile.close();
+    }
+  if(outfilename!="-")
+    outfile.close();
+  }
+
+
+// Vet and write the first nvet rows of tces, which end a group. The rows after them are read by SECECLIPSE.
+
+void VETSYSTEM(ostream &out, tcestore &tces, flagstore &fl, const vetconfig &cfg, int nvet)
+  {
+  fl.resize(tces.size());
+  for(int i=0;i<tces.size();i++)
+    tces.num_planets[i] = 0;  // As in a fresh store, for rows COUNTPLANETS leaves alone
+  COUNTPLANETS(tces);
+  VETRANGE(tces,cfg,fl,0,nvet);
+  WRITEOUTPUT(out,tces,fl,0,nvet);
+  if(binoutname!="")
+    WRITEBINARY(binfile,tces,fl,0,nvet);
+  }
+
+
+// Report a malformed input row for PARSEROW, into err if there is one and otherwise with PARSEERROR
+
+bool ROWERROR(const string &filename, int line, const string &msg, string *err)
+  {
+  if(err==nullptr)
+    PARSEERROR(filename,line,msg);
+  *err = msg;
+  return false;
+  }
+
+
+// Report a malformed input row and exit
+
+void PARSEERROR(const string &filename, int line, string msg)
+  {
+  cerr << (filename=="-" ? "stdin" : filename) << ":" << line << ": " << msg << endl;
+  exit(1);
+  }
+
+
+// Helpers for the input tokenizer. Fields are separated by spaces or tabs, rows by newlines.
+
+bool ISSPACE(char c)
+  {
+  return c==' ' || c=='\t' || c=='\r';
+  }
+
+const char* SKIPSPACE(const char *p, const char *eol)
+  {
+  while(p<eol && ISSPACE(*p))
+    p++;
+  return p;
+  }
+
+// Parse one numeric field at p, which must run up to whitespace or the end of the line. Returns the end of the field, or NULL if it is not a number.
+
+template <typename T> const char* PARSENUM(const char *p, const char *eol, T &val)
+  {
+  if(p<eol && *p=='+')  // from_chars doesn't take a leading plus sign, the stream extractors did
+    p++;
+  from_chars_result res = from_chars(p,eol,val);
+  if(res.ec!=errc() || (res.ptr<eol && !ISSPACE(*res.ptr)))
+    return NULL;
+  return res.ptr;
+  }
+
+// Decode a KKKKKKKKK-PP TCE id into KIC and planet number
+
+bool DECODETCE(const char *p, const char *e, int &kic, int &pn)
+  {
+  const char *dash = (const char*)memchr(p,'-',e-p);
+  if(dash==NULL || dash==p || dash+1==e)
+    return false;
+  from_chars_result res = from_chars(p,dash,kic);
+  if(res.ec!=errc() || res.ptr!=dash)
+    return false;
+  res = from_chars(dash+1,e,pn);
+  return res.ec==errc() && res.ptr==e;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to vet every file in the --batch manifest in one process. The files are parsed at the same time, largest
+// first, then the groups of all of them are cut into pieces of about BATCHPIECE rows and vetted together on one
+// pool, so a mix of small and large files keeps every thread busy. Each output is the same as vetting that file alone.
+// A file that fails to parse is reported and gets no output, the others are still written, and robovet exits with 1.
+
+void BATCH()
+  {
+  const int BATCHPIECE = 4096;
+  vector<pair<string,string> > jobs = READMANIFEST(batchname);
+  int nfiles = jobs.size();
+  vector<tcestore> sets(nfiles);
+  vector<flagstore> fls(nfiles);
+  vector<string> errs(nfiles);  // Why each file failed to parse, empty if it didn't
+  
+  auto t0 = chrono::steady_clock::now();
+  vector<pair<off_t,int> > bysize(nfiles);  // Parse the largest files first, so they don't start last
+  for(int f=0;f<nfiles;f++)
+    {
+    struct stat st;
+    bysize[f] = make_pair(stat(jobs[f].first.c_str(),&st)==0 ? -st.st_size : 0,f);
+    }
+  sort(bysize.begin(),bysize.end());
+  PARALLELFOR(nfiles,nthreads,1,[&](int first, int last)
+    {
+    for(int k=first;k<last;k++)
+      {
+      int f = bysize[k].second;
+      if(LOADDATA(jobs[f].first,sets[f],&errs[f])>=0)
+        COUNTPLANETS(sets[f]);
+      }
+    });
+  if(ephemmatch)
+    for(int f=0;f<nfiles;f++)
+      if(errs[f].empty())
+        EPHEMMATCHFILES(sets[f],config);
+  auto t1 = chrono::steady_clock::now();
+  
+  // One list of pieces across all the files: file, first row and last row
+  struct piece {int f,first,last;};
+  vector<piece> pieces;
+  long nrows = 0;
+  for(int f=0;f<nfiles;f++)
+    {
+    vector<int> groupstart = FINDGROUPS(sets[f]);
+    fls[f].resize(sets[f].size());
+    nrows += sets[f].size();
+    for(size_t g=0,start=0;g+1<groupstart.size();g++)
+      if(groupstart[g+1]-groupstart[start]>=BATCHPIECE || g+2==groupstart.size())
+        {
+        pieces.push_back({f,groupstart[start],groupstart[g+1]});
+        start = g+1;
+        }
+    }
+  PARALLELFOR(pieces.size(),nthreads,1,[&](int first, int last)
+    {
+    for(int p=first;p<last;p++)
+      VETRANGE(sets[pieces[p].f],config,fls[pieces[p].f],pieces[p].first,pieces[p].last);
+    });
+  auto t2 = chrono::steady_clock::now();
+  
+  int nfailed = 0;
+  for(int f=0;f<nfiles;f++)
+    {
+    if(!errs[f].empty())
+      {
+      cerr << jobs[f].first << ": " << errs[f] << ", " << jobs[f].second << " not written" << endl;
+      nfailed++;
+      continue;
+      }
+    outfile.open(jobs[f].second.c_str());
+    if(!outfile)
+      {
+      cerr << "Cannot write " << jobs[f].second << endl;
+      exit(1);
+      }
+    WRITEHEADER(outfile);
+    WRITEOUTPUT(outfile,sets[f],fls[f],0,sets[f].size());
+    outfile.close();
+    }
+  auto t3 = chrono::steady_clock::now();
+  
+  if(timing)
+    {
+    cerr << nfiles << " files" << endl;
+    REPORTTIME("parse",t1-t0,nrows);
+    REPORTTIME("vet",t2-t1,nrows);
+    REPORTTIME("write",t3-t2,nrows);
+    REPORTTIME("total",t3-t0,nrows);
+    }
+  if(nfailed>0)
+    exit(1);
+  }
+
+
+// Function to answer vetting requests, on the Unix domain socket servename or on stdin and stdout, until killed.
+// The thresholds are worked out once, at startup, and each connection gets a thread that answers its requests in
+// turn, so separate clients are served at the same time.
+
+void SERVE()
+  {
+  signal(SIGPIPE,SIG_IGN);  // A client that goes away is only the end of its connection
+  if(servename=="-")
+    {
+    SERVECONN(0,1);
+    return;
+    }
+  
+  sockaddr_un addr;
+  memset(&addr,0,sizeof addr);
+  addr.sun_family = AF_UNIX;
+  if(servename.size()>=sizeof addr.sun_path)
+    {
+    cerr << servename << ": socket path too long" << endl;
+    exit(1);
+    }
+  strcpy(addr.sun_path,servename.c_str());
+  struct stat st;
+  if(stat(servename.c_str(),&st)==0 && S_ISSOCK(st.st_mode))  // Left behind by an earlier server
+    unlink(servename.c_str());
+  int lfd = socket(AF_UNIX,SOCK_STREAM,0);
+  if(lfd<0 || bind(lfd,(sockaddr*)&addr,sizeof addr)!=0 || listen(lfd,64)!=0)
+    {
+    cerr << "Cannot listen on " << servename << ": " << strerror(errno) << endl;
+    exit(1);
+    }
+  for(;;)
+    {
+    int fd = accept(lfd,NULL,NULL);
+    if(fd>=0)
+      thread(SERVECONN,fd,fd).detach();
+    }
+  }
+
+
+// Function to answer the requests on one connection, read from in and answered on out, until the client closes it.
+// A request is one or more rows in the input file format, one per line, ended by a blank line. Lines starting with #,
+// such as the input file header, are skipped. The rows are vetted as a catalog on their own, usually one KIC system,
+// and the answer is the output line of each row, exactly as in an output file, ended by a blank line. A malformed row
+// is answered by "ERROR line N: ..." and a blank line instead. Space is kept from request to request, so once the
+// largest request has been seen, answering doesn't allocate.
+
+void SERVECONN(int in, int out)
+  {
+  tcestore tces;
+  flagstore fl;
+  string reply,err;
+  vector<char> buf(1<<16);
+  size_t have=0;  // Bytes in buf not yet used
+  int n=0, line=0;  // Rows and lines of the current request
+  bool bad=false;  // A row of the current request is malformed
+  for(;;)
+    {
+    ssize_t got = read(in,buf.data()+have,buf.size()-have);
+    if(got<0 && errno==EINTR)
+      continue;
+    if(got<=0)
+      break;
+    have += got;
+    
+    const char *p = buf.data(), *end = buf.data()+have, *eol;
+    while((eol = (const char*)memchr(p,'\n',end-p))!=NULL)
+      {
+      line++;
+      const char *q = SKIPSPACE(p,eol);
+      if(q==eol)  // End of the request
+        {
+        if(!bad && n>0)
+          {
+          tces.resize(n);
+          fl.resize(n);
+          COUNTPLANETS(tces);
+          VETRANGE(tces,config,fl,0,n);
+          FORMATROWS(reply,tces,fl,0,n);
+          }
+        reply += '\n';
+        if(!WRITEALL(out,reply))
+          break;
+        reply.clear();
+        n = line = 0;
+        bad = false;
+        }
+      else if(*q!='#' && !bad)
+        {
+        if(tces.size()<=n)
+          tces.resize(n+1);
+        if(PARSEROW(tces,"request",p,eol,line,n,&err))
+          n++;
+        else
+          {
+          bad = true;
+          reply = "ERROR line " + to_string(line) + ": " + err + "\n";
+          }
+        }
+      p = eol+1;
+      }
+    if(eol!=NULL)  // Couldn't write the answer
+      break;
+    
+    // Keep the partial line for the next read, making room if one line fills the whole buffer
+    have = end-p;
+    memmove(buf.data(),p,have);
+    if(have==buf.size())
+      buf.resize(2*buf.size());
+    }
+  if(in!=0)
+    close(in);
+  }
+
+
+// Write all of str to fd, or return false
+
+bool WRITEALL(int fd, const string &str)
+  {
+  for(size_t done=0;done<str.size();)
+    {
+    ssize_t put = write(fd,str.data()+done,str.size()-done);
+    if(put<0 && errno==EINTR)
+      continue;
+    if(put<=0)
+      return false;
+    done += put;
+    }
+  return true;
+  }
+
+
+// Function to read a --batch manifest. Each line is one of
+//
+//   INFILE OUTFILE          vet INFILE into OUTFILE
+//   PATTERN OUTDIR          vet every file matching the shell wildcard PATTERN, each into the file of the same
+//                           name in OUTDIR
+//
+// Blank lines and anything after a # are ignored. An input that isn't a readable file, or an output that is also an
+// input or appears twice, is an error, so a bad manifest stops before any file is parsed.
+
+vector<pair<string,string> > READMANIFEST(const string &filename)
+  {
+  ifstream file;
+  if(filename!="-")
+    {
+    file.open(filename.c_str());
+    if(file.fail()==1) // If file doesn't exist, exit with warning
+      {
+      cerr << filename << " doesn't exist or cannot open file..." << endl;
+      exit(1);
+      }
+    }
+  istream &in = (filename=="-") ? cin : file;
+  auto checkinput = [&](const string &path, int lineno)
+    {
+    struct stat st;
+    if(stat(path.c_str(),&st)!=0 || !S_ISREG(st.st_mode) || access(path.c_str(),R_OK)!=0)
+      PARSEERROR(filename,lineno,path + " doesn't exist or cannot open file");
+    };
+  
+  vector<pair<string,string> > jobs;
+  string line,from,to,extra;
+  for(int lineno=1; getline(in,line); lineno++)
+    {
+    istringstream ss(line.substr(0,line.find('#')));
+    if(!(ss >> from))
+      continue;
+    if(!(ss >> to) || (ss >> extra))
+      PARSEERROR(filename,lineno,"expected INFILE OUTFILE");
+    if(from.find_first_of("*?[")==string::npos)
+      {
+      checkinput(from,lineno);
+      jobs.push_back(make_pair(from,to));
+      continue;
+      }
+    glob_t g;
+    if(glob(from.c_str(),0,NULL,&g)!=0)
+      PARSEERROR(filename,lineno,"no files match '" + from + "'");
+    for(size_t k=0;k<g.gl_pathc;k++)
+      {
+      string path = g.gl_pathv[k];
+      checkinput(path,lineno);
+      jobs.push_back(make_pair(path,to + "/" + path.substr(path.rfind('/')+1)));
+      }
+    globfree(&g);
+    }
+  
+  vector<string> names;
+  for(size_t j=0;j<jobs.size();j++)
+    {
+    names.push_back(jobs[j].first);
+    names.push_back(jobs[j].second);
+    }
+  sort(names.begin(),names.end());
+  for(size_t j=0;j<jobs.size();j++)
+    if(upper_bound(names.begin(),names.end(),jobs[j].second)-lower_bound(names.begin(),names.end(),jobs[j].second)>1)
+      {
+      cerr << filename << ": " << jobs[j].second << " is written more than once, or is also an input" << endl;
+      exit(1);
+      }
+  return jobs;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to evaluate every threshold configuration in the sweep grid over the input, and over the injected
+// set if one was given, in one run. Each data set is parsed once and shared by all the configurations, and
+// VETSWEEP vets them all block by block, so the columns are read once per block whatever the number of
+// configurations. With --ephemmatch, the ephemeris match flags depend on psig_thresh and
+// esig_thresh, so each pair of them in the grid gets its own copy of the data sets to match them in. Writes one
+// line per configuration with its thresholds and PC/FP counts.
+
+void SWEEP()
+  {
+  vector<vetconfig> configs = READGRID(sweepfilename);
+  
+  int nsets = (injectfilename=="") ? 1 : 2;
+  vector<tcestore> sets(nsets);  // Data set d with the e'th ephemeris match flags is sets[e*nsets+d]
+  LOADDATA(infilename,sets[0]);
+  if(nsets==2)
+    LOADDATA(injectfilename,sets[1]);
+  for(int d=0;d<nsets;d++)
+    {
+    COUNTPLANETS(sets[d]);
+    CACHEPAIRS(sets[d],nthreads);  // Period and epoch comparisons don't depend on the thresholds, so only do them once
+    }
+  vector<int> ephemof(configs.size(),0);  // Which ephemeris match flags each configuration uses
+  if(ephemmatch)
+    {
+    vector<size_t> firstuse;  // First configuration with each pair of psig_thresh and esig_thresh
+    for(size_t c=0;c<configs.size();c++)
+      {
+      size_t e=0;
+      while(e<firstuse.size() && (configs[firstuse[e]].psig_thresh!=configs[c].psig_thresh || configs[firstuse[e]].esig_thresh!=configs[c].esig_thresh))
+        e++;
+      if(e==firstuse.size())
+        firstuse.push_back(c);
+      ephemof[c] = e;
+      }
+    sets.resize(firstuse.size()*nsets);
+    for(size_t e=firstuse.size();e-->0;)  // Last first, so the originals are still there to copy
+      for(int d=0;d<nsets;d++)
+        {
+        tcestore &tces = sets[e*nsets+d];
+        if(e>0)
+          tces = sets[d];
+        tces.ephem_match_disp.resize(tces.size());  // Its own column, not a view of a --cache file shared with the copies
+        EPHEMMATCHFILES(tces,configs[firstuse[e]]);
+        }
+    }
+  
+  vector<int> npc(configs.size()*nsets);  // Number of PCs for each configuration and data set
+  for(size_t e=0;e*nsets<sets.size();e++)
+    {
+    vector<vetconfig> cfgs;  // The configurations with these ephemeris match flags
+    vector<size_t> which;
+    for(size_t c=0;c<configs.size();c++)
+      if(ephemof[c]==(int)e)
+        {
+        cfgs.push_back(configs[c]);
+        which.push_back(c);
+        }
+    vector<int> count;
+    for(int d=0;d<nsets;d++)
+      {
+      VETSWEEP(sets[e*nsets+d],cfgs,count,nthreads);
+      for(size_t j=0;j<which.size();j++)
+        npc[which[j]*nsets+d] = count[j];
+      }
+    }
+  
+  // Write the report
+  outfile.open(outfilename.c_str());
+  int col=1;
+  outfile << "# " << col++ << ":Config";
+  for(int k=0;k<NTHRESH;k++)
+    outfile << "  " << col++ << ":" << THRESHNAMES[k];
+  const char *counts[] = {"N_PC","N_FP","Inj_N_PC","Inj_N_FP","Inj_Recovery"};
+  for(int k=0;k<(nsets==2 ? 5 : 2);k++)
+    outfile << "  " << col++ << ":" << counts[k];
+  outfile << endl;
+  outfile << setprecision(15);
+  for(size_t c=0;c<configs.size();c++)
+    {
+    outfile << c+1;
+    for(int k=0;k<NTHRESH;k++)
+      outfile << " " << configs[c].*THRESHFIELDS[k];
+    outfile << " " << npc[c*nsets] << " " << sets[0].size()-npc[c*nsets];
+    if(nsets==2)
+      outfile << " " << npc[c*nsets+1] << " " << sets[1].size()-npc[c*nsets+1] << " " << (sets[1].size()>0 ? double(npc[c*nsets+1])/sets[1].size() : 0.0);
+    outfile << "\n";
+    }
+  outfile.close();
+  }
+
+
+// Read the uncertainties for --mc. Each line is a column name (see TCE_DOUBLE_COLUMNS) and its uncertainty, either
+// absolute, or relative to the value when it ends in %, or both, e.g. "lpp_tps 0.0001 5%". Anything after # is a comment.
+
+void READSIGMAS(const string &filename, mcsigmas &sig)
+  {
+  ifstream sigfile(filename.c_str());
+  if(sigfile.fail()==1) // If file doesn't exist, exit with warning
+    {
+    cerr << filename << " doesn't exist or cannot open file..." << endl;
+    exit(1);
+    }
+  
+  string line,name,tok;
+  double val;
+  for(int lineno=1; getline(sigfile,line); lineno++)
+    {
+    istringstream ss(line.substr(0,line.find('#')));
+    if(!(ss >> name))
+      continue;
+    int c = FINDCOLUMN(name);
+    if(c<0)
+      PARSEERROR(filename,lineno,"unknown column '" + name + "'");
+    if(!(ss >> tok))
+      PARSEERROR(filename,lineno,"no uncertainty for " + name);
+    do
+      {
+      bool rel = tok.back()=='%';
+      if(!TODOUBLE(rel ? tok.substr(0,tok.size()-1) : tok,val) || val<0)
+        PARSEERROR(filename,lineno,"bad uncertainty '" + tok + "'");
+      if(rel)
+        sig.rel[c] = val/100;
+      else
+        sig.abs[c] = val;
+      }
+    while(ss >> tok);
+    }
+  }
+
+
+// Index of a double column in DOUBLECOLS by name, or -1
+
+int FINDCOLUMN(const string &name)
+  {
+  for(int c=0;c<NDOUBLECOLS;c++)
+    if(name==DOUBLECOLNAMES[c])
+      return c;
+  return -1;
+  }
+
+
+// Function to read a sweep grid file. Each line is one of
+//
+//   NAME V1 V2 ...          values to try for threshold NAME
+//   NAME LO:HI:STEP         evenly spaced values from LO to HI
+//   config NAME=V NAME=V    one configuration, with the thresholds not given left as they are
+//
+// The value lines are expanded into every combination of their values, and the config lines are added after
+// those. Thresholds that aren't given are the ones from --config and --set, or the DR24 values. Threshold names
+// are the ones in VET_THRESHOLDS. Blank lines and anything after a # are ignored.
+
+vector<vetconfig> READGRID(const string &filename)
+  {
+  ifstream gridfile(filename.c_str());
+  if(gridfile.fail()==1) // If file doesn't exist, exit with warning
+    {
+    cerr << filename << " doesn't exist or cannot open file..." << endl;
+    exit(1);
+    }
+  
+  vector<vetconfig> configs;
+  vector<pair<int,vector<double> > > axes;  // Threshold, and values to try for it
+  string line,name,tok;
+  double val,lo,hi,step;
+  for(int lineno=1; getline(gridfile,line); lineno++)
+    {
+    istringstream ss(line.substr(0,line.find('#')));
+    if(!(ss >> name))
+      continue;
+    
+    if(name=="config")
+      {
+      vetconfig cfg = config;
+      string err;
+      while(ss >> tok)
+        if(!SETTHRESH(tok,cfg,err))
+          PARSEERROR(filename,lineno,err);
+      configs.push_back(cfg);
+      continue;
+      }
+    
+    int k = FINDTHRESH(name);
+    if(k<0)
+      PARSEERROR(filename,lineno,"unknown threshold '" + name + "'");
+    vector<double> vals;
+    while(ss >> tok)
+      {
+      size_t c1 = tok.find(':'), c2 = tok.find(':',c1+1);
+      if(c1==string::npos && TODOUBLE(tok,val))
+        vals.push_back(val);
+      else if(c1!=string::npos && c2!=string::npos && TODOUBLE(tok.substr(0,c1),lo) && TODOUBLE(tok.substr(c1+1,c2-c1-1),hi) && TODOUBLE(tok.substr(c2+1),step) && step>0)
+        for(int n=0; n<=int((hi-lo)/step+1e-9); n++)
+          vals.push_back(lo+n*step);
+      else
+        PARSEERROR(filename,lineno,"bad value or range '" + tok + "'");
+      }
+    if(vals.empty())
+      PARSEERROR(filename,lineno,"no values for " + name);
+    axes.push_back(make_pair(k,vals));
+    }
+  
+  // Expand the value lines into every combination
+  if(!axes.empty())
+    {
+    vector<vetconfig> grid(1,config),next;
+    for(size_t a=0;a<axes.size();a++)
+      {
+      next.clear();
+      for(size_t g=0;g<grid.size();g++)
+        for(size_t v=0;v<axes[a].second.size();v++)
+          {
+          next.push_back(grid[g]);
+          next.back().*THRESHFIELDS[axes[a].first] = axes[a].second[v];
+          }
+      grid.swap(next);
+      }
+    configs.insert(configs.begin(),grid.begin(),grid.end());
+    }
+  
+  if(configs.empty())  // Nothing to sweep, so just report the thresholds from --config and --set, or DR24
+    configs.push_back(config);
+  for(size_t c=0;c<configs.size();c++)
+    configs[c].update();
+  return configs;
+  }
+
+
+// Function to read a threshold file for --config. Each line is "NAME VALUE", with the names in VET_THRESHOLDS, and
+// thresholds that aren't given keep their values. Blank lines and anything after a # are ignored.
+
+void READCONFIG(const string &filename, vetconfig &cfg)
+  {
+  ifstream cfgfile(filename.c_str());
+  if(cfgfile.fail()==1) // If file doesn't exist, exit with warning
+    {
+    cerr << filename << " doesn't exist or cannot open file..." << endl;
+    exit(1);
+    }
+  
+  string line,name,tok,extra;
+  for(int lineno=1; getline(cfgfile,line); lineno++)
+    {
+    istringstream ss(line.substr(0,line.find('#')));
+    if(!(ss >> name))
+      continue;
+    if(!(ss >> tok) || (ss >> extra))
+      PARSEERROR(filename,lineno,"expected NAME VALUE");
+    string err;
+    if(!SETTHRESH(name + "=" + tok,cfg,err))
+      PARSEERROR(filename,lineno,err);
+    }
+  cfg.update();
+  }
+
+
+// Set a threshold from NAME=VALUE. Returns false, with what was wrong in err, for a missing =, an unknown name or a
+// bad value.
+
+bool SETTHRESH(const string &tok, vetconfig &cfg, string &err)
+  {
+  double val;
+  size_t eq = tok.find('=');
+  if(eq==string::npos)
+    {
+    err = "expected THRESHOLD=VALUE, found '" + tok + "'";
+    return false;
+    }
+  int k = FINDTHRESH(tok.substr(0,eq));
+  if(k<0)
+    {
+    err = "unknown threshold '" + tok.substr(0,eq) + "', see VET_THRESHOLDS in RoboVetter.h";
+    return false;
+    }
+  if(!TODOUBLE(tok.substr(eq+1),val))
+    {
+    err = "bad value '" + tok.substr(eq+1) + "' for " + tok.substr(0,eq);
+    return false;
+    }
+  cfg.*THRESHFIELDS[k] = val;
+  return true;
+  }
+
+
+// Look up a threshold by name, or return -1
+
+int FINDTHRESH(const string &name)
+  {
+  for(int k=0;k<NTHRESH;k++)
+    if(name==THRESHNAMES[k])
+      return k;
+  return -1;
+  }
+
+
+// Convert a whole string to a double
+
+bool TODOUBLE(const string &str, double &val)
+  {
+  const char *p = PARSENUM(str.c_str(),str.c_str()+str.size(),val);
+  return p!=NULL && p==str.c_str()+str.size();
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to check the fast ephemeris matching against the original on every pair of TCEs the tests compare.
+// Each period match decision of PERIODMATCH is checked against PSIG, and the whole catalog is vetted with the
+// pair comparisons of COMPPT and of COMPPTREF to check that the epoch wrapping leads to the same flags. Uses the
+// thresholds of --config and --set, so it checks the run it stands in for.
+
+void CHECKEPHEM()
+  {
+  tcestore tces;
+  LOADDATA(infilename,tces);
+  COUNTPLANETS(tces);
+  const vetconfig &cfg = config;  // The thresholds of the run being checked, with --config and --set
+
+  // The original way, with every period match going through PSIG, and the fast way
+  auto t0 = chrono::steady_clock::now();
+  CACHEPAIRS(tces,nthreads,COMPPTREF,cfg.mission_dur);
+  vector<char> refmatch(tces.pairs.size());
+  for(size_t p=0;p<tces.pairs.size();p++)
+    refmatch[p] = sqrt(2)*INVERFC(tces.pairs[p].pfrac) > cfg.psig_thresh;
+  auto t1 = chrono::steady_clock::now();
+  vector<ephemcmp> refpairs = tces.pairs;
+  CACHEPAIRS(tces,nthreads,COMPPT,cfg.mission_dur);
+  vector<char> match(tces.pairs.size());
+  for(size_t p=0;p<tces.pairs.size();p++)
+    match[p] = PERIODMATCH(tces.pairs[p],cfg);
+  auto t2 = chrono::steady_clock::now();
+
+  long nmatch=0,nbadmatch=0,nbaddt=0;
+  for(size_t p=0;p<refpairs.size();p++)
+    {
+    nmatch += refmatch[p];
+    if(match[p]!=refmatch[p])
+      nbadmatch++;
+    if(tces.pairs[p].dt!=refpairs[p].dt || tces.pairs[p].dtend!=refpairs[p].dtend)
+      nbaddt++;
+    }
+
+  // Epochs a whole number and a half periods apart are where one step wrapping and the loops are easiest to tell
+  // apart, and real catalogs rarely have them exactly, so check a spread of them too. Built in binary, these are
+  // exact ties, and the wrapped differences must be the same to the bit.
+  long nties=0,nbadties=0;
+  const double tieperiods[] = {1.0,1.001,0.75,3.0,10.5,372.5};
+  for(double P1 : tieperiods)
+    for(double P2 : tieperiods)
+      for(int k=-4;k<=4;k++)
+        {
+        double T2 = 100.0 + (k+0.5)*min(P1,P2);
+        ephemcmp a = COMPPT(P1,P2,100.0,T2), b = COMPPTREF(P1,P2,100.0,T2);
+        nties++;
+        if(a.dt!=b.dt || a.dtend!=b.dtend)
+          nbadties++;
+        }
+  
+  // Ties between epochs read from decimal text, as in an input file, are off by a rounding or two, which the wrapping
+  // has to put on the same side of 0 as the loops. They must also stay within half a period.
+  const double decperiods[] = {1.001,1.0015,0.7531,2.4707,13.3333,372.5123};
+  const char *decepochs[] = {"100.0","131.5","140.0085","1234.5678"};
+  char buf[32];
+  for(const char *e : decepochs)
+    for(double P1 : decperiods)
+      for(double P2 : decperiods)
+        for(int k=-40;k<=40;k++)
+          {
+          double T1 = atof(e);
+          snprintf(buf,sizeof buf,"%.4f",T1 + (k+0.5)*min(P1,P2));
+          double T2 = atof(buf), P = min(P1,P2);
+          ephemcmp a = COMPPT(P1,P2,T1,T2), b = COMPPTREF(P1,P2,T1,T2);
+          nties++;
+          if((a.dt<0)!=(b.dt<0) || fabs(a.dt)>0.5*P)
+            nbadties++;
+          }
+
+  flagstore fast,ref;
+  fast.resize(tces.size());
+  ref.resize(tces.size());
+  VETRANGE(tces,cfg,fast,0,tces.size());
+  tces.pairs.swap(refpairs);
+  VETRANGE(tces,cfg,ref,0,tces.size());
+  int nbadtce=0,firstbad=-1;
+  for(int i=0;i<tces.size();i++)
+    if(fast.minorflags[i]!=ref.minorflags[i] || fast.not_transit_like[i]!=ref.not_transit_like[i] || fast.sig_sec_eclipse[i]!=ref.sig_sec_eclipse[i] || fast.planet_occultation[i]!=ref.planet_occultation[i] || fast.period_is_double[i]!=ref.period_is_double[i])
+      {
+      if(firstbad<0)
+        firstbad=i;
+      nbadtce++;
+      }
+
+  cout << refpairs.size() << " TCE pairs compared, " << nmatch << " period matches" << endl;
+  cout << "Period match decisions differing from PSIG: " << nbadmatch << endl;
+  cout << "Pairs with an epoch difference off by rounding: " << nbaddt << endl;
+  cout << "Half period epoch ties wrapped differently: " << nbadties << " of " << nties << endl;
+  cout << "TCEs with different flags: " << nbadtce;
+  if(firstbad>=0)
+    cout << ", first is " << tces.tce[firstbad];
+  cout << endl;
+  cout << "Pair comparisons and period matching took " << chrono::duration<double>(t1-t0).count() << " s with PSIG, " << chrono::duration<double>(t2-t1).count() << " s now" << endl;
+  if(nbadmatch>0 || nbadtce>0 || nbadties>0)
+    exit(1);
+  }
+
+
+// Function to check the vetting against the reference engine. INFILE is vetted by VETALL, as robovet normally would,
+// and by VETREF, and every TCE is compared flag by flag. With an EXPECTED output file, VETALL's results are also
+// compared against the results in it. Both engines vet the same parsed rows, grouped into systems by the same code,
+// so only the EXPECTED file can catch a mistake there.
+
+void VERIFY()
+  {
+  tcestore tces;
+  LOADDATA(infilename,tces);
+  vector<int> order;  // Input line of each row
+  if(sortinput)
+    SORTSYSTEMS(tces,order,nthreads);
+  else
+    COUNTPLANETS(tces);
+  if(order.empty() || keyorder)
+    {
+    order.resize(tces.size());
+    for(int i=0;i<tces.size();i++)
+      order[i] = i;
+    }
+  if(ephemmatch)
+    EPHEMMATCHFILES(tces,config);
+  
+  flagstore fast,ref;
+  auto t0 = chrono::steady_clock::now();
+  VETALL(tces,config,fast,nthreads);
+  auto t1 = chrono::steady_clock::now();
+  VETREF(tces,config,ref);
+  auto t2 = chrono::steady_clock::now();
+  double tfast = chrono::duration<double>(t1-t0).count(), tref = chrono::duration<double>(t2-t1).count();
+  
+  cout << tces.size() << " TCEs vetted by both engines" << endl;
+  cout << "Shared by both engines, so not checked: parsing, --cache, --sort, --ephemmatch, and the grouping into systems (COUNTPLANETS, BEHIND, AHEAD)" << endl;
+  cout << "Reference took " << tref << " s, vetting took " << tfast << " s on " << max(nthreads,1) << " thread" << (nthreads>1 ? "s" : "") << ", " << tref/tfast << "x faster" << endl;
+  long nbad = REPORTDIFFS("vetting","reference",tces,order,fast,ref);
+  if(expectname!="")
+    {
+    flagstore expect;
+    READEXPECTED(expectname,tces,order,expect);
+    nbad += REPORTDIFFS("vetting",expectname.c_str(),tces,order,fast,expect);
+    }
+  if(nbad>0)
+    exit(1);
+  }
+
+
+// Report which TCEs of a and b have any flag or minor flag different, how many differ in each, and the first of them.
+// Returns the number of TCEs that differ.
+
+long REPORTDIFFS(const char *aname, const char *bname, const tcestore &tces, const vector<int> &order, const flagstore &a, const flagstore &b)
+  {
+  const char* const names[] = {"disposition","not_transit_like","sig_sec_eclipse","centroid_offset","ephemeris_match","planet_occultation","period_is_double"};
+  const int nfields = sizeof names/sizeof names[0];
+  vector<long> count(nfields+NMINORFLAGS,0);
+  long nbad=0;
+  int first=-1;  // Row of the first disagreement in input order
+  for(int i=0;i<tces.size();i++)
+    {
+    const int va[] = {ISFP(a,i),a.not_transit_like[i],a.sig_sec_eclipse[i],a.centroid_offset[i],a.ephemeris_match[i],a.planet_occultation[i],a.period_is_double[i]};
+    const int vb[] = {ISFP(b,i),b.not_transit_like[i],b.sig_sec_eclipse[i],b.centroid_offset[i],b.ephemeris_match[i],b.planet_occultation[i],b.period_is_double[i]};
+    bool bad=false;
+    for(int f=0;f<nfields;f++)
+      if(va[f]!=vb[f])
+        {
+        count[f]++;
+        bad=true;
+        }
+    for(int f=0;f<NMINORFLAGS;f++)
+      if(((a.minorflags[i]^b.minorflags[i])>>f) & 1)
+        {
+        count[nfields+f]++;
+        bad=true;
+        }
+    if(bad)
+      {
+      nbad++;
+      if(first<0 || order[i]<order[first])
+        first=i;
+      }
+    }
+  
+  cout << "TCEs where " << aname << " and " << bname << " disagree: " << nbad << endl;
+  if(nbad==0)
+    return 0;
+  for(int f=0;f<nfields+NMINORFLAGS;f++)
+    if(count[f]>0)
+      cout << "  " << (f<nfields ? names[f] : MINORFLAGNAMES[f-nfields]) << ": " << count[f] << endl;
+  int i=first;
+  cout << "First is " << tces.tce[i] << " on line " << order[i]+2 << ": " << aname << " says " << (ISFP(a,i) ? "FP" : "PC") << " ";
+  string flags;
+  WRITEFLAGS(flags,a.minorflags[i]);
+  cout << flags << ", " << bname << " says " << (ISFP(b,i) ? "FP" : "PC") << " ";
+  flags.clear();
+  WRITEFLAGS(flags,b.minorflags[i]);
+  cout << flags << endl;
+  return nbad;
+  }
+
+
+// Function to read the results in an output file into expect, for the same input as tces. Its line order[i] is row i.
+// planet_occultation and period_is_double aren't written out, but follow from the minor flags, and the disposition
+// column must then agree with ISFP.
+
+void READEXPECTED(const string &filename, const tcestore &tces, const vector<int> &order, flagstore &expect)
+  {
+  ifstream in(filename.c_str());
+  if(!in)
+    {
+    cerr << filename << " doesn't exist or cannot open file..." << endl;
+    exit(1);
+    }
+  vector<int> rowof(tces.size());
+  for(int i=0;i<tces.size();i++)
+    rowof[order[i]] = i;
+  expect.resize(tces.size());
+  string line,tce,disp,name;
+  int lineno=0, n=0;
+  while(getline(in,line))
+    {
+    lineno++;
+    if(line.empty() || line[0]=='#')
+      continue;
+    if(n>=tces.size())
+      PARSEERROR(filename,lineno,"more rows than the " + to_string(tces.size()) + " in " + infilename);
+    int i = rowof[n++];
+    istringstream ss(line);
+    if(!(ss >> tce >> disp >> expect.not_transit_like[i] >> expect.sig_sec_eclipse[i] >> expect.centroid_offset[i] >> expect.ephemeris_match[i]))
+      PARSEERROR(filename,lineno,"expected TCE, disposition and four flags");
+    if(tce!=tces.tce[i])
+      PARSEERROR(filename,lineno,"TCE " + tce + " where " + infilename + " has " + tces.tce[i]);
+    expect.minorflags[i]=0;
+    string flags;
+    ss >> flags;
+    for(size_t p=0;p<flags.size();)
+      {
+      size_t e = flags.find("---",p);
+      name = flags.substr(p,e==string::npos ? string::npos : e-p);
+      int f=0;
+      while(f<NMINORFLAGS && name!=MINORFLAGNAMES[f])
+        f++;
+      if(f==NMINORFLAGS)
+        PARSEERROR(filename,lineno,"unknown minor flag '" + name + "'");
+      expect.minorflags[i] |= 1u<<f;
+      p = (e==string::npos) ? flags.size() : e+3;
+      }
+    expect.planet_occultation[i] = (expect.minorflags[i] & (FLAGBIT(DV_SEC_COULD_BE_DUE_TO_PLANET) | FLAGBIT(ALT_SEC_COULD_BE_DUE_TO_PLANET)))!=0;
+    expect.period_is_double[i] = (expect.minorflags[i] & (FLAGBIT(DV_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD) | FLAGBIT(ALT_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD)))!=0;
+    if(disp!=(ISFP(expect,i) ? "FP" : "PC"))
+      PARSEERROR(filename,lineno,"disposition " + disp + " doesn't follow from the flags");
+    }
+  if(n<tces.size())
+    {
+    cerr << filename << " has " << n << " rows, " << infilename << " has " << tces.size() << endl;
+    exit(1);
+    }
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to compute ephem_match_disp with EPHEMMATCH and the thresholds of cfg, with the sky positions of --coords
+// and the known systems of --ephemlist
+
+void EPHEMMATCHFILES(tcestore &tces, const vetconfig &cfg)
+  {
+  coordmap coords;
+  vector<ephement> known;
+  if(coordsname!="")
+    coords = READCOORDS(coordsname);
+  if(ephemlistname!="")
+    READEPHEMLIST(ephemlistname,coords,known);
+  EPHEMMATCH(tces,cfg,coords,known,nthreads);
+  }
+
+
+// Function to read sky positions, "KIC RA DEC" in degrees per line
+
+coordmap READCOORDS(const string &filename)
+  {
+  ifstream coordfile(filename.c_str());
+  if(coordfile.fail()==1) // If file doesn't exist, exit with warning
+    {
+    cerr << filename << " doesn't exist or cannot open file..." << endl;
+    exit(1);
+    }
+  coordmap coords;
+  string line;
+  for(int lineno=1; getline(coordfile,line); lineno++)
+    {
+    istringstream ss(line.substr(0,line.find('#')));
+    string tok;
+    int kic;
+    double ra,dec;
+    if(!(ss >> tok))
+      continue;
+    if(!(istringstream(tok) >> kic) || !(ss >> ra >> dec))
+      PARSEERROR(filename,lineno,"expected KIC RA DEC");
+    coords[kic] = make_pair(ra,dec);
+    }
+  return coords;
+  }
+
+
+// Function to read known eclipsing binaries or KOIs for EPHEMMATCH, "NAME PERIOD EPOCH [RA DEC]" per line, with
+// the epoch in the same time system as the TCEs. A NAME that is a KIC number keeps the system from matching TCEs on
+// its own star, and takes the star's position from the coordinates file if it has none of its own.
+
+void READEPHEMLIST(const string &filename, const coordmap &coords, vector<ephement> &ents)
+  {
+  ifstream listfile(filename.c_str());
+  if(listfile.fail()==1) // If file doesn't exist, exit with warning
+    {
+    cerr << filename << " doesn't exist or cannot open file..." << endl;
+    exit(1);
+    }
+  string line,name;
+  for(int lineno=1; getline(listfile,line); lineno++)
+    {
+    istringstream ss(line.substr(0,line.find('#')));
+    double ra,dec;
+    ephement e = {0,0,0,{0,0,0},-1,-1};
+    if(!(ss >> name))
+      continue;
+    if(!(ss >> e.period >> e.epoch))
+      PARSEERROR(filename,lineno,"expected NAME PERIOD EPOCH [RA DEC]");
+    if(from_chars(name.data(),name.data()+name.size(),e.kic).ptr!=name.data()+name.size())
+      e.kic=-1;
+    auto c = coords.find(e.kic);
+    if(ss >> ra >> dec)
+      SETPOS(e,ra,dec);
+    else if(c!=coords.end())
+      SETPOS(e,c->second.first,c->second.second);
+    ents.push_back(e);
+    }
+  }
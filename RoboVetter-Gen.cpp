@@ -0,0 +1,264 @@
+/*
+ * Synthetic input catalogs for the DR24 Robovetter, for testing and benchmarking at scale
+ *
+ * Compile via: make robogen
+ *
+ * Run as ./robogen NTCES OUTFILE
+ *
+ * Options:
+ *
+ *   --seed S   Random seed, the same seed always gives the same file (default 1)
+ *   --inject   One transit-like TCE per star, like the injected transit set, instead of a mix of systems
+ *
+ * Systems are a mix of planet hosts, eclipsing binaries and false alarms, with realistic multiplicities. Later TCEs
+ * in a system are often the secondary eclipse of the first, a residual of it, or a period alias of it, so the
+ * tests that compare TCEs within a system (ISSEC, RESID_OF_PREV_TCE, OTHER_TCE_AT_SAME_PERIOD_DIFF_EPOCH and so on)
+ * all get exercised. The metric distributions straddle the DR24 thresholds, so every test fires on some TCEs.
+ *
+ */
+
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+#include <charconv>
+
+using namespace std;
+
+// Kinds of TCE
+enum tcekind {PLANET, EB, FALSEALARM, SECONDARY, RESIDUAL, ALIAS};
+
+// Metrics of one TCE, in input file order
+struct tcerow {double period,epoch,duration,max_ses_in_mes,mes,lpp_tps,lpp_trap,marshall,dv_oesig,alt_oesig,
+                      dv_sig_pri,dv_sig_sec,dv_sig_ter,dv_sig_pos,dv_fred,dv_sig_fa,dv_del_fa,
+                      alt_sig_pri,alt_sig_sec,alt_sig_ter,alt_sig_pos,alt_fred,alt_sig_fa,alt_del_fa,
+                      dv_rp,impact,dv_alb,dv_mod_pridepth,dv_mod_secdepth,dv_ph_sec,alt_alb,alt_mod_pridepth,alt_mod_secdepth,alt_ph_sec;
+               int robo_cent_disp,ephem_match_disp;
+              };
+
+// Declare variables
+mt19937_64 rng;
+
+// Declare Functions
+double UNIFORM(double,double), LOGUNIFORM(double,double), GAUSS(double,double);
+bool CHANCE(double);
+int PICK(const vector<double>&);
+tcerow MAKETCE(tcekind,const tcerow*,double);
+void WRITEROW(string&,int,int,const tcerow&);
+
+
+int main (int argc, char* argv[])
+  {
+  vector<string> args;
+  bool inject=false;
+  for(int a=1;a<argc;a++)
+    {
+    string opt = argv[a];
+    if(opt=="--seed" && a+1<argc)
+      rng.seed(strtoull(argv[++a],NULL,10));
+    else if(opt=="--inject")
+      inject = true;
+    else
+      args.push_back(opt);
+    }
+  if(args.size()!=2 || atol(args[0].c_str())<=0)
+    {
+    cerr << "Usage: " << argv[0] << " [--seed S] [--inject] NTCES OUTFILE" << endl;
+    exit(1);
+    }
+  long ntces = atol(args[0].c_str());
+  FILE *out = fopen(args[1].c_str(),"w");
+  if(out==NULL)
+    {
+    cerr << "Cannot write " << args[1] << endl;
+    exit(1);
+    }
+
+  string buf = "# TCE Period Epoch Duration Max_SES MES LPP_DV LPP_Alt Marshall DV_OE Alt_OE DV_MS_Pri DV_MS_Sec DV_MS_Ter DV_MS_Pos DV_MS_Fred DV_MS_FA DV_MS_DeltaFA "
+                "Alt_MS_Pri Alt_MS_Sec Alt_MS_Ter Alt_MS_Pos Alt_MS_Fred Alt_MS_FA Alt_MS_DeltaFA Rp Impact DV_Albedo DV_PriDepth DV_SecDepth DV_SecPhase "
+                "Alt_Albedo Alt_PriDepth Alt_SecDepth Alt_SecPhase Centroid_Disp Ephem_Match_Disp\n";
+  int kic = 757000;
+  const vector<double> multiplicity = {70,15,7,4,2,1,1};  // Chance of 1 through 7 TCEs on a star
+  for(long n=0;n<ntces;)
+    {
+    kic += 1 + rng()%40;
+
+    // The first TCE is the strongest signal on the star, and the later ones are often related to it
+    int ntce = inject ? 1 : 1+PICK(multiplicity);
+    tcekind first = inject ? PLANET : (tcekind)PICK({50,25,25});
+    tcerow prim = MAKETCE(first,NULL,LOGUNIFORM(0.5,500));
+    for(int pn=1;pn<=ntce && n<ntces;pn++,n++)
+      {
+      tcerow row = prim;
+      if(pn>1)
+        {
+        tcekind kind = (first==EB) ? (tcekind)PICK({10,0,5,50,15,20}) : (tcekind)PICK({55,0,10,5,20,10});
+        row = MAKETCE(kind,&prim,LOGUNIFORM(0.5,500));
+        }
+      WRITEROW(buf,kic,inject ? 1+PICK({80,15,5}) : pn,row);
+      if(buf.size()>(1<<20))
+        {
+        fwrite(buf.data(),1,buf.size(),out);
+        buf.clear();
+        }
+      }
+    }
+  fwrite(buf.data(),1,buf.size(),out);
+  if(fclose(out)!=0)
+    {
+    cerr << "Cannot write " << args[1] << endl;
+    exit(1);
+    }
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to make one TCE of the given kind. Secondaries, residuals and aliases are made relative to prim.
+
+tcerow MAKETCE(tcekind kind, const tcerow *prim, double period)
+  {
+  tcerow t;
+
+  // Ephemeris
+  t.period = period;
+  t.epoch = 131.5 + UNIFORM(0,min(period,300.0));
+  t.duration = min(24.0*period/4,exp(GAUSS(log(2.5*cbrt(period)),0.4)));  // Hours, rising with period
+  if(prim!=NULL)
+    {
+    if(kind==SECONDARY)  // Same period, half an orbit (or a bit off for eccentric orbits) later
+      {
+      t.period = prim->period*(1+GAUSS(0,2e-6));
+      t.epoch = prim->epoch + prim->period*(CHANCE(0.7) ? 0.5 : UNIFORM(0.2,0.8));
+      t.duration = prim->duration*UNIFORM(0.8,1.2);
+      }
+    else if(kind==RESIDUAL)  // What's left of the primary's transits after it was fitted
+      {
+      t.period = prim->period*(1+GAUSS(0,1e-5));
+      t.epoch = prim->epoch + GAUSS(0,prim->duration/24.0);
+      t.duration = prim->duration*UNIFORM(0.5,1.5);
+      }
+    else if(kind==ALIAS)  // A multiple or fraction of the primary's period, through the same transits
+      {
+      const double ratios[] = {2,3,0.5,1.0/3,1.5,2.0/3};
+      t.period = prim->period*ratios[rng()%6]*(1+GAUSS(0,1e-5));
+      t.epoch = prim->epoch + (CHANCE(0.5) ? 0.0 : prim->period*(rng()%3));
+      t.duration = prim->duration*UNIFORM(0.8,1.2);
+      }
+    }
+  bool transitlike = (kind==PLANET || kind==EB || kind==SECONDARY || kind==ALIAS) && CHANCE(0.85);
+  bool eclipsing = (kind==EB || kind==SECONDARY || (kind==ALIAS && prim->dv_mod_pridepth>20000));
+
+  // Detection strength
+  t.mes = 7.1 + exp(GAUSS(2.0,1.2));
+  t.max_ses_in_mes = t.mes*(transitlike ? UNIFORM(0.05,0.8) : UNIFORM(0.5,1.1));
+
+  // Light curve shape metrics, straddling the LPP, Marshall and odd-even cuts
+  t.lpp_tps = transitlike ? exp(GAUSS(log(0.0012),0.5)) : exp(GAUSS(log(0.004),0.6));
+  t.lpp_trap = t.lpp_tps*exp(GAUSS(-0.2,0.3));
+  t.marshall = transitlike ? exp(GAUSS(1.0,1.0)) : exp(GAUSS(2.5,0.8));
+  t.dv_oesig = fabs(GAUSS(0,eclipsing ? 2.5 : 0.8));
+  t.alt_oesig = fabs(t.dv_oesig + GAUSS(0,0.3));
+
+  // Model-shift significances. A ter or pos of 0 means the feature wasn't found.
+  double depth = eclipsing ? LOGUNIFORM(2000,300000) : LOGUNIFORM(30,5000);  // ppm
+  double *pri[2] = {&t.dv_sig_pri,&t.alt_sig_pri}, *sec[2] = {&t.dv_sig_sec,&t.alt_sig_sec}, *ter[2] = {&t.dv_sig_ter,&t.alt_sig_ter}, *pos[2] = {&t.dv_sig_pos,&t.alt_sig_pos};
+  double *fred[2] = {&t.dv_fred,&t.alt_fred}, *fa[2] = {&t.dv_sig_fa,&t.alt_sig_fa}, *del[2] = {&t.dv_del_fa,&t.alt_del_fa};
+  double *pridepth[2] = {&t.dv_mod_pridepth,&t.alt_mod_pridepth}, *secdepth[2] = {&t.dv_mod_secdepth,&t.alt_mod_secdepth};
+  double *phsec[2] = {&t.dv_ph_sec,&t.alt_ph_sec}, *alb[2] = {&t.dv_alb,&t.alt_alb};
+  double secfrac = eclipsing ? UNIFORM(0.02,0.9) : (CHANCE(0.1) ? UNIFORM(0.001,0.08) : 0.0);  // Secondary depth over primary
+  double phase = CHANCE(0.7) ? 0.5+GAUSS(0,0.002) : UNIFORM(0,1);
+  for(int d=0;d<2;d++)
+    {
+    *fred[d] = exp(GAUSS(0.2,0.3));
+    *fa[d] = UNIFORM(3.5,6.5);
+    *del[d] = UNIFORM(1.5,5);
+    *pri[d] = transitlike ? t.mes*UNIFORM(0.6,1.2) : t.mes*UNIFORM(0.1,0.7);
+    *sec[d] = secfrac>0 ? *pri[d]*secfrac*UNIFORM(0.8,1.2) + GAUSS(0,1) : GAUSS(0,2);
+    *ter[d] = CHANCE(0.4) ? 0.0 : GAUSS(transitlike ? 1 : 5,3);
+    *pos[d] = CHANCE(0.4) ? 0.0 : GAUSS(transitlike ? 1 : 5,3);
+    *pridepth[d] = depth*UNIFORM(0.9,1.1);
+    *secdepth[d] = depth*secfrac*UNIFORM(0.8,1.2);
+    *phsec[d] = min(1.0,max(0.0,phase+GAUSS(0,0.001)));
+    *alb[d] = secfrac>0 ? exp(GAUSS(-0.5,1.0)) : UNIFORM(-0.5,0.5);
+    }
+  if(kind==SECONDARY && CHANCE(0.3))  // Twin stars, with the secondary as deep as the primary
+    {
+    t.dv_mod_pridepth = prim->dv_mod_pridepth*UNIFORM(0.95,1.05);
+    t.dv_sig_pri = prim->dv_sig_pri*UNIFORM(0.95,1.05);
+    }
+  t.dv_rp = eclipsing ? LOGUNIFORM(8,150) : LOGUNIFORM(0.5,25);
+  t.impact = UNIFORM(0,eclipsing ? 1.3 : 1.0);
+
+  t.robo_cent_disp = CHANCE(eclipsing ? 0.2 : 0.05);
+  t.ephem_match_disp = CHANCE(0.03);
+  return t;
+  }
+
+
+// Function to append one input row to buf. Numbers are written with ten significant digits.
+
+void WRITEROW(string &buf, int kic, int pn, const tcerow &t)
+  {
+  char num[32];
+  snprintf(num,sizeof num,"%09d-%02d",kic,pn);
+  buf += num;
+  const double vals[] = {t.period,t.epoch,t.duration,t.max_ses_in_mes,t.mes,t.lpp_tps,t.lpp_trap,t.marshall,t.dv_oesig,t.alt_oesig,
+                         t.dv_sig_pri,t.dv_sig_sec,t.dv_sig_ter,t.dv_sig_pos,t.dv_fred,t.dv_sig_fa,t.dv_del_fa,
+                         t.alt_sig_pri,t.alt_sig_sec,t.alt_sig_ter,t.alt_sig_pos,t.alt_fred,t.alt_sig_fa,t.alt_del_fa,
+                         t.dv_rp,t.impact,t.dv_alb,t.dv_mod_pridepth,t.dv_mod_secdepth,t.dv_ph_sec,t.alt_alb,t.alt_mod_pridepth,t.alt_mod_secdepth,t.alt_ph_sec};
+  for(double v : vals)
+    {
+    buf += ' ';
+    buf.append(num,to_chars(num,num+sizeof num,v,chars_format::general,10).ptr);
+    }
+  buf += t.robo_cent_disp ? " 1" : " 0";
+  buf += t.ephem_match_disp ? " 1\n" : " 0\n";
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Random number helpers
+
+double UNIFORM(double lo, double hi)
+  {
+  return lo + (hi-lo)*((rng()>>11)*0x1.0p-53);
+  }
+
+double LOGUNIFORM(double lo, double hi)
+  {
+  return exp(UNIFORM(log(lo),log(hi)));
+  }
+
+double GAUSS(double mean, double sigma)
+  {
+  double u1 = UNIFORM(1e-300,1), u2 = UNIFORM(0,1);
+  return mean + sigma*sqrt(-2*log(u1))*cos(2*M_PI*u2);
+  }
+
+bool CHANCE(double p)
+  {
+  return UNIFORM(0,1) < p;
+  }
+
+// Pick an index with chance proportional to its weight
+
+int PICK(const vector<double> &weights)
+  {
+  double total=0;
+  for(double w : weights)
+    total += w;
+  double x = UNIFORM(0,total);
+  for(size_t k=0;k<weights.size();k++)
+    {
+    if(x<weights[k])
+      return k;
+    x -= weights[k];
+    }
+  return weights.size()-1;
+  }
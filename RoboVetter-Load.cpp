@@ -0,0 +1,245 @@
+/*
+ * Load generator for the DR24 Robovetter service, ./robovet --serve SOCKET, to measure its request latency
+ *
+ * Compile via: make roboload
+ *
+ * Run as ./roboload SOCKET INFILE
+ *
+ * Options:
+ *
+ *   --conns C     Connections to keep busy at once, each on its own thread (default 4)
+ *   --seconds S   How long to keep sending requests for (default 5)
+ *   --rows R      Rows per request: whole systems of INFILE are packed into each request until it has at least R
+ *                 rows (default 1, so one system per request)
+ *
+ * INFILE is a catalog in the input format, such as ./robogen writes. Each connection sends its requests one at a
+ * time, waiting for the answer before sending the next, and starts at a different place in the catalog. Every answer
+ * is checked to have one output line per row. At the end, the request rate and the latency percentiles, from just
+ * before a request is sent until the whole answer has arrived, are written in microseconds.
+ *
+ */
+
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+// One request, ready to send
+struct request {string text; int rows;};
+
+// What one connection measured
+struct connresult {vector<double> latency; long errors=0;};
+
+// Declare variables
+string socketname;
+int conns=4;  // Connections, each on its own thread
+vector<request> requests;
+
+// Declare Functions
+vector<request> READREQUESTS(const string&,int);
+void RUNCONN(int,double,connresult&);
+int CONNECT();
+bool SENDALL(int,const string&);
+double PERCENTILE(const vector<double>&,double);
+
+
+int main (int argc, char* argv[])
+  {
+  vector<string> args;
+  int rows=1;
+  double seconds=5;
+  for(int a=1;a<argc;a++)
+    {
+    string opt = argv[a];
+    if(opt=="--conns" && a+1<argc)
+      conns = atoi(argv[++a]);
+    else if(opt=="--seconds" && a+1<argc)
+      seconds = atof(argv[++a]);
+    else if(opt=="--rows" && a+1<argc)
+      rows = atoi(argv[++a]);
+    else
+      args.push_back(opt);
+    }
+  if(args.size()!=2 || conns<1 || seconds<=0 || rows<1)
+    {
+    cerr << "Usage: ./roboload [--conns C] [--seconds S] [--rows R] SOCKET INFILE" << endl;
+    exit(1);
+    }
+  socketname = args[0];
+  requests = READREQUESTS(args[1],rows);
+  if(requests.empty())
+    {
+    cerr << args[1] << " has no rows" << endl;
+    exit(1);
+    }
+
+  vector<connresult> results(conns);
+  vector<thread> threads;
+  auto start = chrono::steady_clock::now();
+  for(int c=0;c<conns;c++)
+    threads.emplace_back(RUNCONN,c,seconds,ref(results[c]));
+  for(auto &t : threads)
+    t.join();
+  double elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+  vector<double> all;
+  long errors=0;
+  for(auto &r : results)
+    {
+    all.insert(all.end(),r.latency.begin(),r.latency.end());
+    errors += r.errors;
+    }
+  sort(all.begin(),all.end());
+  printf("%zu requests on %d connections in %.2f s, %.0f requests/s, %ld bad answers\n",all.size(),conns,elapsed,all.size()/elapsed,errors);
+  printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",PERCENTILE(all,0.5),PERCENTILE(all,0.9),PERCENTILE(all,0.99),
+         PERCENTILE(all,0.999),all.empty() ? 0.0 : all.back());
+  return errors>0;
+  }
+
+
+// Read INFILE and cut it into requests of whole systems, at least rows rows each where the file allows
+
+vector<request> READREQUESTS(const string &filename, int rows)
+  {
+  ifstream in(filename.c_str());
+  if(!in)
+    {
+    cerr << filename << " doesn't exist or cannot open file..." << endl;
+    exit(1);
+    }
+  vector<request> reqs;
+  request cur{"",0};
+  string line,kic,lastkic;
+  while(getline(in,line))
+    {
+    if(line.empty() || line[0]=='#')
+      continue;
+    kic = line.substr(0,line.find('-'));
+    if(cur.rows>=rows && kic!=lastkic)  // Only a new system starts a new request
+      {
+      cur.text += '\n';
+      reqs.push_back(cur);
+      cur = request{"",0};
+      }
+    cur.text += line + '\n';
+    cur.rows++;
+    lastkic = kic;
+    }
+  if(cur.rows>0)
+    {
+    cur.text += '\n';
+    reqs.push_back(cur);
+    }
+  return reqs;
+  }
+
+
+// Send requests on one connection for the given time, timing each one until its whole answer has arrived
+
+void RUNCONN(int c, double seconds, connresult &res)
+  {
+  int fd = CONNECT();
+  size_t next = requests.size()*c/conns;  // Spread the connections over the catalog
+  string answer;
+  vector<char> buf(1<<16);
+  auto stop = chrono::steady_clock::now() + chrono::duration<double>(seconds);
+  while(chrono::steady_clock::now()<stop)
+    {
+    const request &req = requests[next];
+    next = (next+1)%requests.size();
+    auto sent = chrono::steady_clock::now();
+    if(!SENDALL(fd,req.text))
+      {
+      cerr << "Server closed the connection" << endl;
+      exit(1);
+      }
+
+    // The answer ends with a blank line
+    answer.clear();
+    while(answer.size()<2 || answer.compare(answer.size()-2,2,"\n\n")!=0)
+      {
+      ssize_t got = read(fd,buf.data(),buf.size());
+      if(got<0 && errno==EINTR)
+        continue;
+      if(got<=0)
+        {
+        cerr << "Server closed the connection" << endl;
+        exit(1);
+        }
+      answer.append(buf.data(),got);
+      }
+    res.latency.push_back(chrono::duration<double,micro>(chrono::steady_clock::now()-sent).count());
+
+    if(count(answer.begin(),answer.end(),'\n')!=req.rows+1 || answer.compare(0,6,"ERROR ")==0)
+      {
+      if(res.errors==0)
+        cerr << "Bad answer: " << answer.substr(0,answer.find('\n')) << endl;
+      res.errors++;
+      }
+    }
+  close(fd);
+  }
+
+
+// Connect to the service
+
+int CONNECT()
+  {
+  sockaddr_un addr;
+  memset(&addr,0,sizeof addr);
+  addr.sun_family = AF_UNIX;
+  if(socketname.size()>=sizeof addr.sun_path)
+    {
+    cerr << socketname << ": socket path too long" << endl;
+    exit(1);
+    }
+  strcpy(addr.sun_path,socketname.c_str());
+  int fd = socket(AF_UNIX,SOCK_STREAM,0);
+  if(fd<0 || connect(fd,(sockaddr*)&addr,sizeof addr)!=0)
+    {
+    cerr << "Cannot connect to " << socketname << ": " << strerror(errno) << endl;
+    exit(1);
+    }
+  return fd;
+  }
+
+
+// Write all of str to fd, or return false
+
+bool SENDALL(int fd, const string &str)
+  {
+  for(size_t done=0;done<str.size();)
+    {
+    ssize_t put = send(fd,str.data()+done,str.size()-done,MSG_NOSIGNAL);
+    if(put<0 && errno==EINTR)
+      continue;
+    if(put<=0)
+      return false;
+    done += put;
+    }
+  return true;
+  }
+
+
+// The p'th quantile of sorted values, 0 if there are none
+
+double PERCENTILE(const vector<double> &sorted, double p)
+  {
+  if(sorted.empty())
+    return 0;
+  size_t i = min(sorted.size()-1,(size_t)(p*sorted.size()));
+  return sorted[i];
+  }
@@ -0,0 +1,1770 @@
+/* 
+ * Kepler Q1-Q17 DR24 Robovetter library, see RoboVetter.h
+ * 
+ * Compile via: make lib
+ * 
+ */
+
+
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <math.h>
+#include <algorithm>
+#include <numeric>
+#include "RoboVetter.h"
+
+using namespace std;
+
+const int VETBLOCK = 256;  // Rows per ROWMASKS call in VETRANGE
+const int MCBATCH = VETBLOCK;  // Rows of replicas per VETRANGE call in MCSCORE
+const int MCTABLE = 4096;  // Bins of the inverse normal table in MCGAUSS
+const int MCEDGE = 16;  // Bins at each end of it worked out in full
+const int RADIXBLOCK = 1<<16;  // Fewest keys per block of RADIXSORT
+
+// Declare Functions
+template <class C> void ROWMASKS(const tcestore&,const C&,int,int,uint32_t*);
+template <class C> void TRANSITLIKE(const tcestore&,const C&,flagstore&,int,uint32_t,vetstats*);
+template <class C> void SECECLIPSE(const tcestore&,const C&,flagstore&,int,uint32_t,vetstats*);
+template <class C> void ISSEC(const tcestore&,const C&,flagstore&,int,int&,vetstats*);
+template <class C> void VETRANGET(const tcestore&,const C&,flagstore&,int,int,vetstats*);
+template <class C> unsigned VETROW(const tcestore&,const C&,flagstore&,int,int,uint32_t,int&,vetstats*);
+template <class C> void VETROWS(const tcestore&,const C&,flagstore&,int,int,const uint32_t*);
+void COUNTROW(vetstats&,const tcestore&,const flagstore&,int,unsigned,uint32_t), COUNTSYSTEM(vetstats&,uint64_t);
+uint64_t MCHASH(uint64_t,uint64_t);
+ephemcmp PAIRCMP(const tcestore&,int,int,double);
+bool FRACPASS(double,double,double,double), SAMEMASKS(const vetconfig&,const vetconfig&);
+double WRAPDT(double,double);
+void ISSECREF(const tcestore&,const vetconfig&,flagstore&,int,int&), TRANSITLIKEREF(const tcestore&,const vetconfig&,flagstore&,int), SECECLIPSEREF(const tcestore&,const vetconfig&,flagstore&,int);
+double PSIGREF(const tcestore&,int,int);
+
+// The DR24 thresholds as compile time constants. The tests are templates on the type of their thresholds, and
+// VETRANGE vets with this one whenever a vetconfig is at the defaults, so the DR24 values are built into that code.
+struct dr24config {
+#define X(name,val) static constexpr double name = val;
+  VET_THRESHOLDS(X)
+#undef X
+  static constexpr uint32_t disabled = 0;
+  double pfrac_lo,pfrac_hi,lppsig,lppdv,lppalt;  // Worked out at run time, as for any vetconfig
+  dr24config(const vetconfig &cfg) : pfrac_lo(cfg.pfrac_lo), pfrac_hi(cfg.pfrac_hi), lppsig(cfg.lppsig), lppdv(cfg.lppdv), lppalt(cfg.lppalt) {}
+  };
+bool PERIODMATCH(const ephemcmp&,const dr24config&);
+
+
+// Work out the values that follow from the thresholds
+
+void vetconfig::update()
+  {
+  PFRACCUTS(psig_thresh,pfrac_lo,pfrac_hi);
+  lppsig = sqrt(2)*INVERFC(1.0/lpp_ntces);  // Fixed to the OPS run number of 20,367 for both ops and injected by default, so they use same thresholds
+  lppdv = lpp_dv_const + lppsig*lpp_dv_slope;  // NEW value based on fitting gaussian to injections. Susan OLD value was lppsig*0.000781
+  lppalt = lpp_alt_const + lppsig*lpp_alt_slope;  // NEW value based on fitting gaussian to injections. Susan OLD value was lppsig*0.001001
+  }
+
+bool vetconfig::isdr24() const
+  {
+#define X(name,val) if(name!=val) return false;
+  VET_THRESHOLDS(X)
+#undef X
+  return true;
+  }
+
+
+// Add another thread's or run's counts to these
+
+void vetstats::add(const vetstats &o)
+  {
+  rows += o.rows;
+  systems += o.systems;
+  for(int t=0;t<NVETTESTS;t++)
+    {
+    calls[t] += o.calls[t];
+    fires[t] += o.fires[t];
+    pairs[t] += o.pairs[t];
+    }
+  for(int f=0;f<NMINORFLAGS;f++)
+    {
+    evaluated[f] += o.evaluated[f];
+    fired[f] += o.fired[f];
+    }
+  for(int b=0;b<NPAIRBINS;b++)
+    pairbins[b] += o.pairbins[b];
+  maxpairs = max(maxpairs,o.maxpairs);
+  seconds += o.seconds;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to vet an array of TCEs. The rows are copied into the columns of work, which keep their capacity
+// from call to call, and vetted there.
+
+void VET(const tcerow *rows, int n, tceresult *results, const vetconfig &cfg, vetwork &work, int nthreads)
+  {
+  tcestore &tces = work.tces;
+  tces.resize(n);
+  for(int i=0;i<n;i++)
+    {
+#define X(col) tces.col[i] = rows[i].col;
+    TCE_INT_COLUMNS(X)
+    TCE_DOUBLE_COLUMNS(X)
+#undef X
+    }
+  COUNTPLANETS(tces);
+  VETALL(tces,cfg,work.fl,nthreads);
+  
+  const flagstore &fl = work.fl;
+  for(int i=0;i<n;i++)
+    {
+    tceresult &r = results[i];
+    r.fp = ISFP(fl,i);
+    r.not_transit_like = fl.not_transit_like[i];
+    r.sig_sec_eclipse = fl.sig_sec_eclipse[i];
+    r.centroid_offset = fl.centroid_offset[i];
+    r.ephemeris_match = fl.ephemeris_match[i];
+    r.planet_occultation = fl.planet_occultation[i];
+    r.period_is_double = fl.period_is_double[i];
+    r.minorflags = fl.minorflags[i];
+    }
+  }
+
+
+// Function to vet every row of tces. Groups share no state, so they can be vetted in any order on any number of threads.
+
+void VETALL(const tcestore &tces, const vetconfig &cfg, flagstore &fl, int nthreads, vector<vetstats> *stats)
+  {
+  fl.resize(tces.size());
+  if(stats)
+    stats->assign(max(nthreads,1),vetstats());
+  if(nthreads<=1)  // One pass over the whole catalog, no need to find the groups
+    {
+    VETRANGE(tces,cfg,fl,0,tces.size(),stats ? &(*stats)[0] : nullptr);
+    return;
+    }
+  vector<int> groupstart = FINDGROUPS(tces);
+  PARALLELFOR(groupstart.size()-1,nthreads,64,[&](int first, int last, int t) {VETRANGE(tces,cfg,fl,groupstart[first],groupstart[last],stats ? &(*stats)[t] : nullptr);});
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Figure out total number of planets in each system. KIC and PN numbers must already be filled in. With a system
+// index it is the number of rows in the system, and without one it is the last planet number, as in DR24.
+
+void COUNTPLANETS(tcestore &tces)
+  {
+  int i,j,ntces=tces.size();
+  if(!tces.sysstart.empty())
+    {
+    for(i=0;i<ntces;i++)
+      tces.num_planets[i] = tces.sysstart[tces.sysof[i]+1] - tces.sysstart[tces.sysof[i]];
+    return;
+    }
+  for(i=0;i<ntces;i++)
+    {
+    if(i>0 && tces.kic[i] != tces.kic[i-1])  // If we're on a new system, figure out how many total planets in system for each TCE
+      for(j=1;j<=tces.pn[i-1] && j<=i;j++)   // Update number of planets for all previous TCEs in the system
+        tces.num_planets[i-j] = tces.pn[i-1]; 
+    }
+  if(ntces>0)
+    for(j=1;j<=tces.pn[i-1] && j<=i;j++)
+      tces.num_planets[i-j] = tces.pn[i-1];  // Update number of planets for the last system
+  }
+
+
+// Make final PC/FP determination, i.e. the NExScI disposition
+
+bool ISFP(const flagstore &fl, int i)
+  {
+  bool fp=false;
+  if(fl.not_transit_like[i]==1)
+    fp=true;
+  if(fl.sig_sec_eclipse[i]==1 && fl.planet_occultation[i]==0)  
+    fp=true;
+  if(fl.centroid_offset[i]==1)
+    fp=true;
+  if(fl.ephemeris_match[i]==1)
+    fp=true;
+  return fp;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to robo-vet the rows first through last-1, which must start on a group boundary. With the DR24 thresholds
+// this goes through the dr24config instance of the tests, unless cfg.fastpath is turned off to compare the two.
+
+void VETRANGE(const tcestore &tces, const vetconfig &cfg, flagstore &fl, int first, int last, vetstats *stats)
+  {
+  if(cfg.fastpath && cfg.disabled==0 && cfg.isdr24())
+    VETRANGET(tces,dr24config(cfg),fl,first,last,stats);
+  else
+    VETRANGET(tces,cfg,fl,first,last,stats);
+  }
+
+template <class C> void VETRANGET(const tcestore &tces, const C &cfg, flagstore &fl, int first, int last, vetstats *stats)
+  {
+  int secfound=0;  // Int to mark if a secondary has been found in the system
+  uint32_t masks[VETBLOCK];  // Single-TCE test results for the current block of rows, see ROWMASKS
+  unsigned ran;  // Bit t set when test t ran on this TCE, for stats
+  uint64_t syspairs=0;  // Pairs compared before the current system started, for stats
+  chrono::steady_clock::time_point start;
+  if(VETSTATS && stats)
+    start = chrono::steady_clock::now();
+  for(int i=first;i<last;i++)
+    {      
+    if((i-first)%VETBLOCK==0)
+      {
+      ROWMASKS(tces,cfg,i,min(i+VETBLOCK,last),masks);
+      if(cfg.disabled)
+        for(int j=0;j<min(VETBLOCK,last-i);j++)
+          masks[j] &= ~cfg.disabled;
+      }
+    if(VETSTATS && stats && (i==first || tces.kic[i]!=tces.kic[i-1]))
+      {
+      if(i>first)
+        COUNTSYSTEM(*stats,stats->totalpairs()-syspairs);
+      syspairs = stats->totalpairs();
+      }
+
+    ran = VETROW(tces,cfg,fl,i,first,masks[(i-first)%VETBLOCK],secfound,stats);
+    
+    if(VETSTATS && stats)
+      COUNTROW(*stats,tces,fl,i,ran,masks[(i-first)%VETBLOCK]);
+    }
+  
+  if(VETSTATS && stats && last>first)
+    {
+    COUNTSYSTEM(*stats,stats->totalpairs()-syspairs);
+    stats->seconds += chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    }
+  }
+
+
+// Vet row i, the first row vetted being row first, given its mask from ROWMASKS. secfound carries over from one row
+// to the next. Returns the tests that ran on the row, bit t for test t, for stats.
+
+template <class C> inline unsigned VETROW(const tcestore &tces, const C &cfg, flagstore &fl, int i, int first, uint32_t mask, int &secfound, vetstats *stats)
+  {
+  unsigned ran=0;
+  fl.minorflags[i]=0;
+  fl.not_transit_like[i]=fl.sig_sec_eclipse[i]=fl.planet_occultation[i]=fl.period_is_double[i]=fl.centroid_offset[i]=fl.ephemeris_match[i]=0;  // Make sure all flags start at 0 - assumed PC until it fails a test
+  
+  // Let's keep track if we already found a seconary eclipse in the system or not
+  if(i==first || tces.kic[i]!=tces.kic[i-1] || fl.not_transit_like[i-1]==0)  // If it's the first TCE we're looking at, or if it's a new system, or if a transit-like TCE was found in the system since we last found a secondary, start looking for a secondary again.
+    secfound=0;
+  
+  // Check to see if TCE is a secondary eclipse
+  if(secfound==0)
+    {
+    ISSEC(tces,cfg,fl,i,secfound,stats);
+    ran |= 1u<<TEST_ISSEC;
+    }
+  
+  // If not a secondary, check to see if TCE is Transit-Like
+  if(fl.not_transit_like[i]==0 && fl.sig_sec_eclipse[i]==0)
+    {
+    TRANSITLIKE(tces,cfg,fl,i,mask,stats);
+    ran |= 1u<<TEST_TRANSITLIKE;
+    }
+  
+  // Now if it is Transit-Like, check to see if there is a significant secondary eclipse
+  if(fl.not_transit_like[i]==0 && fl.sig_sec_eclipse[i]==0)
+    {
+    SECECLIPSE(tces,cfg,fl,i,mask,stats);
+    ran |= 1u<<TEST_SECECLIPSE;
+    }
+  
+  // Apply robo centroid disposition
+  fl.centroid_offset[i] = (cfg.disabled & 1u<<ABLATE_CENTROID) ? 0 : tces.robo_cent_disp[i];
+  
+  // Apply ephem match disposition
+  fl.ephemeris_match[i] = (cfg.disabled & 1u<<ABLATE_EPHEM) ? 0 : tces.ephem_match_disp[i];
+  
+  
+  return ran;
+  }
+
+
+// Vet the rows first through last-1, which must start on a group boundary, given their masks from ROWMASKS
+
+template <class C> void VETROWS(const tcestore &tces, const C &cfg, flagstore &fl, int first, int last, const uint32_t *masks)
+  {
+  int secfound=0;
+  for(int i=first;i<last;i++)
+    VETROW(tces,cfg,fl,i,first,masks[i-first],secfound,nullptr);
+  }
+
+
+// Count which tests ran on row i, given the tests VETRANGE ran on it as bits of ran, and which of them fired
+
+void COUNTROW(vetstats &st, const tcestore &tces, const flagstore &fl, int i, unsigned ran, uint32_t mask)
+  {
+  bool before = BEHIND(tces,i)<i;  // There are earlier TCEs in the system to compare against
+  bool after = AHEAD(tces,i)>i;  // ...and later ones
+  uint32_t evaluated = 0;
+  st.rows++;
+  if(ran & 1u<<TEST_ISSEC)
+    {
+    st.calls[TEST_ISSEC]++;
+    st.fires[TEST_ISSEC] += (fl.minorflags[i] & FLAGBIT(THIS_TCE_IS_A_SEC))!=0;
+    if(before)
+      evaluated |= FLAGBIT(THIS_TCE_IS_A_SEC);
+    }
+  if(ran & 1u<<TEST_TRANSITLIKE)
+    {
+    st.calls[TEST_TRANSITLIKE]++;
+    st.fires[TEST_TRANSITLIKE] += fl.not_transit_like[i];
+    evaluated |= (FLAGBIT(TRANSITS_NOT_CONSISTENT)<<1) - FLAGBIT(LPP_DV_TOO_HIGH);
+    if(before)
+      evaluated |= FLAGBIT(SAME_P_AS_PREV_NTL_TCE) | FLAGBIT(RESID_OF_PREV_TCE);
+    }
+  if(ran & 1u<<TEST_SECECLIPSE)
+    {
+    st.calls[TEST_SECECLIPSE]++;
+    st.fires[TEST_SECECLIPSE] += fl.sig_sec_eclipse[i];
+    evaluated |= FLAGBIT(SIG_SEC_IN_DV_MODEL_SHIFT) | FLAGBIT(SIG_SEC_IN_ALT_MODEL_SHIFT) | FLAGBIT(DV_ROBO_ODD_EVEN_TEST_FAIL) | FLAGBIT(ALT_ROBO_ODD_EVEN_TEST_FAIL);
+    if(mask & FLAGBIT(SIG_SEC_IN_DV_MODEL_SHIFT))
+      evaluated |= FLAGBIT(DV_SEC_COULD_BE_DUE_TO_PLANET) | FLAGBIT(DV_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD);
+    if(mask & FLAGBIT(SIG_SEC_IN_ALT_MODEL_SHIFT))
+      evaluated |= FLAGBIT(ALT_SEC_COULD_BE_DUE_TO_PLANET) | FLAGBIT(ALT_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD);
+    if(after)
+      evaluated |= FLAGBIT(OTHER_TCE_AT_SAME_PERIOD_DIFF_EPOCH);
+    }
+  for(int f=0;f<NMINORFLAGS;f++)
+    {
+    st.evaluated[f] += (evaluated>>f) & 1;
+    st.fired[f] += (fl.minorflags[i]>>f) & 1;
+    }
+  }
+
+
+// Count a system that had npairs pairs of TCEs compared
+
+void COUNTSYSTEM(vetstats &st, uint64_t npairs)
+  {
+  int b=0;
+  while(b<NPAIRBINS-1 && npairs>>b)
+    b++;
+  st.systems++;
+  st.pairbins[b]++;
+  st.maxpairs = max(st.maxpairs,npairs);
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to evaluate, for rows first through last-1, every test that only reads the row's own columns.
+// Each row gets the FLAGBIT of every such test that holds for it, before any gating between the tests;
+// TRANSITLIKE and SECECLIPSE apply the gating. The rows are processed W at a time with GCC vector
+// extensions. Every comparison is the same IEEE operation as the scalar test it replaces, so the
+// results are identical whatever the vector width. Nothing here may be computed with an FMA, which the wider
+// instruction sets have and x86-64 itself doesn't: the Makefile builds with -ffp-contract=off, and the LPP cuts,
+// the one multiply-add, come in precomputed. GCC only vectorizes these well at the native
+// width of the instruction set the function is compiled for, so ROWMASKSFN defines one function per
+// instruction set, and ROWMASKS picks the widest one the CPU supports.
+
+const int VLENMAX = 8;  // Widest vector, in doubles
+#define VLOAD(col,i) ({vdouble v_; memcpy(&v_,&(col)[i],sizeof v_); v_;})  /* Rows i through i+W-1 */
+#define VABS(v) ((vdouble)((vmask)(v) & INT64_MAX))
+#define FLAGIF(cond,f) ((cond) & (int64_t)FLAGBIT(f))
+#define COL(col) VLOAD(src->col,r)
+
+#define ROWMASKSFN(NAME,W,ATTR) \
+template <class C> ATTR void NAME(const tcestore &tces, const C &cfg, int first, int last, uint32_t *mask) \
+  { \
+  typedef double vdouble __attribute__((vector_size(W*sizeof(double)))); \
+  typedef int64_t vmask __attribute__((vector_size(W*sizeof(double))));  /* All ones in a lane where a comparison holds */ \
+   \
+  const double lppdv = cfg.lppdv, lppalt = cfg.lppalt;  /* LPP cuts, worked out in vetconfig::update, where they can't be contracted into an FMA */ \
+  static thread_local tcestore pad;  /* Zero padded copy of the last few rows, so every load is a full vector */ \
+  for(int b=first;b<last;b+=W) \
+    { \
+    int n=min(W,last-b); \
+    const tcestore *src=&tces; \
+    int r=b; \
+    if(n<W) \
+      { \
+      if(pad.size()!=VLENMAX) \
+        pad.resize(VLENMAX); \
+      TCE_DOUBLE_COLUMNS(PADCOL) \
+      src=&pad; \
+      r=0; \
+      } \
+    vdouble period=COL(period), duration=COL(duration), impact=COL(impact); \
+    vmask m = {}; \
+     \
+    /* LPP, Marshall metric, and consistency of transits via SES to MES ratio */ \
+    m |= FLAGIF(COL(lpp_tps) > lppdv,LPP_DV_TOO_HIGH); \
+    m |= FLAGIF(COL(lpp_trap) > lppalt,LPP_ALT_TOO_HIGH); \
+    m |= FLAGIF(COL(marshall) > cfg.marshall_max,MARSHALL_FAIL); \
+    m |= FLAGIF((COL(max_ses_in_mes)/COL(mes) > cfg.ses_mes_max) & (period > cfg.long_period),TRANSITS_NOT_CONSISTENT);  /* Maybe 0.95?  0.99?   1.0 could work. */ \
+     \
+    /* Model-shift tests on DV detrending. A 0 for ter or pos indicates a NULL result. */ \
+    { \
+    vdouble pri=COL(dv_sig_pri), sec=COL(dv_sig_sec), ter=COL(dv_sig_ter), pos=COL(dv_sig_pos), fred=COL(dv_fred), fa=COL(dv_sig_fa), del=COL(dv_del_fa); \
+    m |= FLAGIF((pri/fred < fa) & (pri > 0),DV_SIG_PRI_OVER_FRED_TOO_LOW);  /* Primary is not significant */ \
+    m |= FLAGIF((pri - ter < del) & (pri > 0) & (ter > 0),DV_SIG_PRI_MINUS_SIG_TER_TOO_LOW);  /* Primary is not significantly greater than tertiary */ \
+    m |= FLAGIF((pri - pos < del) & (pri > 0) & (pos > 0),DV_SIG_PRI_MINUS_SIG_POS_TOO_LOW);  /* Primary is not significantly greater than positive */ \
+    m |= FLAGIF((sec/fred > fa) & (sec > 0) & ((sec - ter > del) | (ter <= 0)) & ((sec - pos > del) | (pos <= 0)),SIG_SEC_IN_DV_MODEL_SHIFT);  /* Secondary is significant, and more significant than ter and pos if they exist */ \
+    vdouble alb=COL(dv_alb), rp=COL(dv_rp); \
+    m |= FLAGIF((alb > 0.0) & (alb < 1.0) & (rp > 0.0) & (rp < 30.0) & (COL(dv_mod_secdepth) < cfg.occ_depth_frac*COL(dv_mod_pridepth)) & (impact < cfg.occ_impact_max),DV_SEC_COULD_BE_DUE_TO_PLANET);  /* Less than 30 earth radii, secondary less than 10% the depth of the primary, and impact parameter less than 0.95 */ \
+    m |= FLAGIF((VABS(0.5 - COL(dv_ph_sec))*period < 0.25*duration/24.0) & (VABS(pri - sec) < del),DV_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD);  /* Secondary could be identical to the transit so that it's really a PC phased at twice the period */ \
+    } \
+     \
+    /* Model-shift tests on Chris' alternate detrending */ \
+    { \
+    vdouble pri=COL(alt_sig_pri), sec=COL(alt_sig_sec), ter=COL(alt_sig_ter), pos=COL(alt_sig_pos), fred=COL(alt_fred), fa=COL(alt_sig_fa), del=COL(alt_del_fa); \
+    m |= FLAGIF((pri/fred < fa) & (pri > 0),ALT_SIG_PRI_OVER_FRED_TOO_LOW); \
+    m |= FLAGIF((pri - ter < del) & (pri > 0) & (ter > 0),ALT_SIG_PRI_MINUS_SIG_TER_TOO_LOW); \
+    m |= FLAGIF((pri - pos < del) & (pri > 0) & (pos > 0),ALT_SIG_PRI_MINUS_SIG_POS_TOO_LOW); \
+    m |= FLAGIF((sec/fred > fa) & (sec > 0) & ((sec - ter > del) | (ter <= 0)) & ((sec - pos > del) | (pos <= 0)),SIG_SEC_IN_ALT_MODEL_SHIFT); \
+    vdouble alb=COL(alt_alb), rp=COL(alt_rp); \
+    m |= FLAGIF((alb > 0.0) & (alb < 1.0) & (rp > 0.0) & (rp < 30.0) & (COL(alt_mod_secdepth) < cfg.occ_depth_frac*COL(alt_mod_pridepth)) & (impact < cfg.occ_impact_max),ALT_SEC_COULD_BE_DUE_TO_PLANET); \
+    m |= FLAGIF((VABS(0.5 - COL(alt_ph_sec))*period < 0.25*duration/24.0) & (VABS(pri - sec) < del),ALT_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD); \
+    } \
+     \
+    /* Odd-Even tests from DV and Chris detrending */ \
+    m |= FLAGIF((period < cfg.long_period) & (COL(dv_oesig) > cfg.oesig_max),DV_ROBO_ODD_EVEN_TEST_FAIL); \
+    m |= FLAGIF((period < cfg.long_period) & (COL(alt_oesig) > cfg.oesig_max),ALT_ROBO_ODD_EVEN_TEST_FAIL); \
+     \
+    for(int l=0;l<n;l++) \
+      mask[b-first+l] = m[l]; \
+    } \
+  }
+#define PADCOL(col) for(int l=0;l<VLENMAX;l++) pad.col[l] = l<n ? tces.col[b+l] : 0.0;
+
+// SSE2 is part of x86-64, and 2 wide is also a fine width for the generic code on other architectures
+#if defined(__x86_64__)
+ROWMASKSFN(ROWMASKS512,8,__attribute__((target("avx512f"))))
+ROWMASKSFN(ROWMASKS256,4,__attribute__((target("avx2"))))
+#endif
+ROWMASKSFN(ROWMASKS128,2,)
+#undef COL
+
+template <class C> void ROWMASKS(const tcestore &tces, const C &cfg, int first, int last, uint32_t *mask)
+  {
+#if defined(__x86_64__)
+  static void (* const kernel)(const tcestore&,const C&,int,int,uint32_t*) = __builtin_cpu_supports("avx512f") ? ROWMASKS512<C> : __builtin_cpu_supports("avx2") ? ROWMASKS256<C> : ROWMASKS128<C>;  // Pick the widest the CPU supports, once
+  kernel(tces,cfg,first,last,mask);
+#else
+  ROWMASKS128(tces,cfg,first,last,mask);
+#endif
+  }
+
+
+// Whether ROWMASKS gives the same masks with configurations a and b: they agree on every threshold it reads, and
+// leave out the same tests
+
+#define ROWMASK_THRESHOLDS(X) X(lppdv) X(lppalt) X(marshall_max) X(ses_mes_max) X(long_period) X(occ_depth_frac) X(occ_impact_max) X(oesig_max)
+
+bool SAMEMASKS(const vetconfig &a, const vetconfig &b)
+  {
+#define X(name) a.name==b.name &&
+  return ROWMASK_THRESHOLDS(X) a.disabled==b.disabled;
+#undef X
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to split the catalog into groups of rows that can be vetted independently of each other.
+// ISSEC and TRANSITLIKE look back at the flags of the rows from BEHIND, which for well formed input or with
+// a system index is the rest of the KIC system. A row whose planet number reaches back past the start of its
+// own system pulls the rows it reaches into its group, so results stay identical to a single pass over the catalog.
+// SECECLIPSE only reads input columns of later rows, so it never ties groups together.
+
+vector<int> FINDGROUPS(const tcestore &tces)
+  {
+  int ntces=tces.size();
+  vector<int> groupstart;
+  vector<char> boundary(ntces+1,0);
+  int reach = ntces;  // Earliest row looked back at by this row or any after it
+  for(int i=ntces-1;i>0;i--)
+    {
+    reach = min(reach,BEHIND(tces,i));
+    if(tces.kic[i]!=tces.kic[i-1] && reach>=i)
+      boundary[i]=1;
+    }
+  
+  if(ntces>0)
+    groupstart.push_back(0);
+  for(int i=1;i<ntces;i++)
+    if(boundary[i])
+      groupstart.push_back(i);
+  groupstart.push_back(ntces);
+  return groupstart;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to count the PCs in tces under each configuration of cfgs, for --sweep. The catalog is cut into blocks of
+// whole groups of up to VETBLOCK rows, and every configuration vets a block while its columns are still in the cache,
+// so they are read from memory once per block rather than once per configuration. Configurations for which SAMEMASKS
+// holds, such as ones that differ only in the thresholds for comparing TCEs, share the ROWMASKS of each block.
+
+void VETSWEEP(const tcestore &tces, const vector<vetconfig> &cfgs, vector<int> &npc, int nthreads)
+  {
+  int ncfgs = cfgs.size();
+  vector<int> maskof(ncfgs);  // Which masks each configuration uses
+  vector<int> maskcfg;  // First configuration with each set of masks
+  vector<char> fast(ncfgs);  // Configurations VETRANGE would vet through dr24config
+  for(int c=0;c<ncfgs;c++)
+    {
+    size_t k=0;
+    while(k<maskcfg.size() && !SAMEMASKS(cfgs[maskcfg[k]],cfgs[c]))
+      k++;
+    if(k==maskcfg.size())
+      maskcfg.push_back(c);
+    maskof[c] = k;
+    fast[c] = cfgs[c].fastpath && cfgs[c].disabled==0 && cfgs[c].isdr24();
+    }
+  
+  vector<int> groupstart = FINDGROUPS(tces), blockstart(1,0);
+  for(size_t g=1;g+1<groupstart.size();g++)
+    if(groupstart[g+1]-blockstart.back() > VETBLOCK)
+      blockstart.push_back(groupstart[g]);
+  blockstart.push_back(tces.size());
+  
+  vector<flagstore> tfl(max(nthreads,1));  // Flags, one per thread, reused by every configuration
+  vector<vector<int> > tnpc(max(nthreads,1),vector<int>(ncfgs,0));  // PCs each thread counted
+  PARALLELFOR(blockstart.size()-1,nthreads,16,[&](int bfirst, int blast, int t)
+    {
+    flagstore &fl = tfl[t];
+    if(fl.minorflags.size()!=(size_t)tces.size())
+      fl.resize(tces.size());
+    vector<uint32_t> masks;  // The masks for each entry of maskcfg, one after the other
+    for(int b=bfirst;b<blast;b++)
+      {
+      int first=blockstart[b], last=blockstart[b+1], n=last-first;
+      masks.resize(maskcfg.size()*n);
+      for(size_t k=0;k<maskcfg.size();k++)
+        {
+        const vetconfig &cfg = cfgs[maskcfg[k]];
+        ROWMASKS(tces,cfg,first,last,&masks[k*n]);
+        if(cfg.disabled)
+          for(int j=0;j<n;j++)
+            masks[k*n+j] &= ~cfg.disabled;
+        }
+      for(int c=0;c<ncfgs;c++)
+        {
+        if(fast[c])
+          VETROWS(tces,dr24config(cfgs[c]),fl,first,last,&masks[maskof[c]*n]);
+        else
+          VETROWS(tces,cfgs[c],fl,first,last,&masks[maskof[c]*n]);
+        for(int i=first;i<last;i++)
+          tnpc[t][c] += !ISFP(fl,i);
+        }
+      }
+    });
+  
+  npc.assign(ncfgs,0);
+  for(size_t t=0;t<tnpc.size();t++)
+    for(int c=0;c<ncfgs;c++)
+      npc[c] += tnpc[t][c];
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to work out which tests each row's disposition depends on, from the flags fl of a full vet. Leaving out a
+// test that never fired in a group changes nothing there, so each group is only vetted again without each of the
+// tests that fired in it, and the work grows with the number of tests that fire rather than the number of tests.
+
+void ABLATE(const tcestore &tces, const vetconfig &cfg, const flagstore &fl, vector<uint64_t> &flips, int nthreads)
+  {
+  vector<int> groupstart = FINDGROUPS(tces);
+  flips.assign(tces.size(),0);
+  vector<flagstore> tfl(max(nthreads,1));  // Flags of the vets without a test, one per thread
+  PARALLELFOR(groupstart.size()-1,nthreads,64,[&](int gfirst, int glast, int t)
+    {
+    flagstore &afl = tfl[t];
+    if(afl.minorflags.size()!=(size_t)tces.size())
+      afl.resize(tces.size());
+    vetconfig acfg = cfg;
+    for(int g=gfirst;g<glast;g++)
+      {
+      int first = groupstart[g], last = groupstart[g+1];
+      uint64_t fired = 0;
+      for(int i=first;i<last;i++)
+        fired |= fl.minorflags[i] | (uint64_t)(fl.centroid_offset[i]!=0)<<ABLATE_CENTROID | (uint64_t)(fl.ephemeris_match[i]!=0)<<ABLATE_EPHEM;
+      for(int u=0;u<NABLATE;u++)
+        if(fired>>u & 1)
+          {
+          acfg.disabled = cfg.disabled | 1u<<u;
+          VETRANGE(tces,acfg,afl,first,last);
+          for(int i=first;i<last;i++)
+            if(ISFP(afl,i)!=ISFP(fl,i))
+              flips[i] |= 1ull<<u;
+          }
+      }
+    });
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to hash each group of rows (see FINDGROUPS) for incremental vetting. A group's hash covers every column
+// of its rows, and the period, epoch and KIC of any later rows that SECECLIPSE compares them against. The first
+// group is hashed differently, as rows there may reach back past the start of the catalog.
+
+vector<uint64_t> HASHGROUPS(const tcestore &tces, const vector<int> &groupstart, int nthreads)
+  {
+  int ngroups = groupstart.size()-1;
+  vector<uint64_t> hash(max(ngroups,0));
+  PARALLELFOR(ngroups,nthreads,256,[&](int first, int last)
+    {
+    for(int g=first;g<last;g++)
+      {
+      const uint64_t K = 0x9E3779B97F4A7C15ull;
+      uint64_t h[8] = {g==0,1,2,(uint64_t)(groupstart[g+1]-groupstart[g]),4,5,6,7};  // Eight lanes, so the multiplies overlap
+      auto add = [&](int lane, uint64_t v) {h[lane&7] = (h[lane&7]^v)*K;};  // Each step is one to one, so any change carries through
+      auto bits = [](double d) {uint64_t b; memcpy(&b,&d,sizeof b); return b;};
+      int reach = groupstart[g+1]-1, lane;
+      for(int i=groupstart[g];i<groupstart[g+1];i++)
+        {
+        lane = 0;
+#define X(col) add(lane++,(uint32_t)tces.col[i]);
+        TCE_INT_COLUMNS(X)
+#undef X
+#define X(col) add(lane++,bits(tces.col[i]));
+        TCE_DOUBLE_COLUMNS(X)
+#undef X
+        reach = max(reach,AHEAD(tces,i));
+        }
+      for(int k=groupstart[g+1];k<=reach;k++)
+        {
+        add(0,(uint32_t)tces.kic[k]);
+        add(1,bits(tces.period[k]));
+        add(2,bits(tces.epoch[k]));
+        }
+      uint64_t sum = 0;
+      for(lane=0;lane<8;lane++)
+        sum = MCHASH(sum,h[lane]);
+      hash[g] = sum;
+      }
+    });
+  return hash;
+  }
+
+
+// Function to vet just the groups with need set. Those groups are copied out, in order, and vetted on their own.
+// A group whose SECECLIPSE comparisons reach into the next groups brings them along, so the copied rows compare
+// against the same rows as in the whole catalog. The KICs of the copies are renumbered so that rows are in the same
+// system only if they were next to each other and in the same system in the whole catalog.
+
+void VETGROUPS(const tcestore &tces, const vetconfig &cfg, flagstore &fl, const vector<int> &groupstart, vector<char> &need, int nthreads, vector<vetstats> *stats)
+  {
+  int ngroups = groupstart.size()-1, until = 0;
+  vector<int> rows;  // Row of tces for each row of the copy
+  for(int g=0;g<ngroups;g++)
+    {
+    if(groupstart[g]<until)
+      need[g] = 1;
+    if(!need[g])
+      continue;
+    for(int i=groupstart[g];i<groupstart[g+1];i++)
+      {
+      rows.push_back(i);
+      until = max(until,AHEAD(tces,i)+1);
+      }
+    }
+  
+  tcestore sub;
+  flagstore subfl;
+  sub.resize(rows.size());
+  int run=0, last=-1;  // KIC run number in the whole catalog, and the row it was worked out for
+  for(size_t o=0;o<rows.size();o++)
+    {
+    int i = rows[o];
+    for(last++;last<=i;last++)
+      if(last>0 && tces.kic[last]!=tces.kic[last-1])
+        run++;
+    last = i;
+#define X(col) sub.col[o] = tces.col[i];
+    TCE_INT_COLUMNS(X)
+    TCE_DOUBLE_COLUMNS(X)
+#undef X
+    sub.kic[o] = run;
+    }
+  if(!tces.sysstart.empty())
+    INDEXSYSTEMS(sub);
+  VETALL(sub,cfg,subfl,nthreads,stats);
+  
+  for(size_t o=0;o<rows.size();o++)
+    {
+    int i = rows[o];
+    fl.not_transit_like[i] = subfl.not_transit_like[o];
+    fl.sig_sec_eclipse[i] = subfl.sig_sec_eclipse[o];
+    fl.planet_occultation[i] = subfl.planet_occultation[o];
+    fl.centroid_offset[i] = subfl.centroid_offset[o];
+    fl.period_is_double[i] = subfl.period_is_double[o];
+    fl.ephemeris_match[i] = subfl.ephemeris_match[o];
+    fl.minorflags[i] = subfl.minorflags[o];
+    }
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to sort a catalog whose rows may come in any order into KIC systems, and index them. Rows with the same
+// KIC and planet number stay in their input order.
+
+void SORTSYSTEMS(tcestore &tces, vector<int> &order, int nthreads)
+  {
+  int n = tces.size();
+  vector<uint64_t> keys(n);
+  for(int i=0;i<n;i++)
+    keys[i] = (uint64_t)(uint32_t)tces.kic[i]<<32 | (uint32_t)tces.pn[i];
+  order = RADIXSORT(keys,nthreads);
+  bool sorted = true;
+  for(int i=0;i<n && sorted;i++)
+    sorted = (order[i]==i);
+  if(!sorted)  // Nothing to move for input that was in order already
+    GATHERROWS(tces,order,nthreads);
+  INDEXSYSTEMS(tces);
+  COUNTPLANETS(tces);
+  }
+
+
+// Function to index the KIC systems of a tcestore whose rows are grouped by KIC
+
+void INDEXSYSTEMS(tcestore &tces)
+  {
+  int n = tces.size();
+  tces.sysstart.clear();
+  tces.sysof.resize(n);
+  for(int i=0;i<n;i++)
+    {
+    if(i==0 || tces.kic[i]!=tces.kic[i-1])
+      tces.sysstart.push_back(i);
+    tces.sysof[i] = tces.sysstart.size()-1;
+    }
+  tces.sysstart.push_back(n);
+  }
+
+
+// Function to rearrange the rows of a tcestore so that row i is the old row order[i], one column per thread.
+// Each thread reuses the space of the columns it has done for the next one. Any pair cache or system index is dropped.
+
+void GATHERROWS(tcestore &tces, const vector<int> &order, int nthreads)
+  {
+  vector<vector<int> > intspace(max(nthreads,1));
+  vector<vector<double> > doublespace(max(nthreads,1));
+  vector<function<void(int)> > cols = {
+    [&](int) {vector<string> g(order.size()); for(size_t i=0;i<order.size();i++) g[i].swap(tces.tce[order[i]]); tces.tce.swap(g);},
+#define X(col) [&](int t) {tces.col.gather(order,intspace[t]);},
+    TCE_INT_COLUMNS(X)
+#undef X
+#define X(col) [&](int t) {tces.col.gather(order,doublespace[t]);},
+    TCE_DOUBLE_COLUMNS(X)
+#undef X
+    };
+  PARALLELFOR(cols.size(),nthreads,1,[&](int first, int last, int t)
+    {
+    for(int c=first;c<last;c++)
+      cols[c](t);
+    });
+  tces.pairstart.clear();
+  tces.sysstart.clear();
+  tces.sysof.clear();
+  }
+
+
+// Function to sort 64-bit keys, returning the indices of the keys in sorted order. It is a stable LSD radix sort,
+// a byte at a time, that skips the bytes that are the same in every key. The keys are split into blocks that are
+// counted and scattered in parallel, and each block gets its own run of each bucket, so the scatter stays stable.
+
+vector<int> RADIXSORT(const vector<uint64_t> &keys, int nthreads)
+  {
+  int n = keys.size();
+  vector<uint64_t> key(keys), nextkey(n);
+  vector<int> order(n), next(n);
+  iota(order.begin(),order.end(),0);
+  uint64_t differ = 0;  // Bits that differ between keys
+  for(int i=1;i<n;i++)
+    differ |= keys[i]^keys[0];
+  
+  int nblocks = max(1,min(n/RADIXBLOCK,4*nthreads));
+  vector<int> count(256*nblocks);  // Bucket-major, so the running sum over it gives each block its run of each bucket
+  auto block = [&](int b) {return (long)n*b/nblocks;};
+  for(int shift=0;shift<64;shift+=8)
+    {
+    if(((differ>>shift) & 0xff)==0)
+      continue;
+    fill(count.begin(),count.end(),0);
+    PARALLELFOR(nblocks,nthreads,1,[&](int first, int last)
+      {
+      for(int b=first;b<last;b++)
+        for(long i=block(b);i<block(b+1);i++)
+          count[(key[i]>>shift & 0xff)*nblocks + b]++;
+      });
+    int sum=0;
+    for(int &c : count)
+      {
+      int here = c;
+      c = sum;
+      sum += here;
+      }
+    PARALLELFOR(nblocks,nthreads,1,[&](int first, int last)
+      {
+      for(int b=first;b<last;b++)
+        for(long i=block(b);i<block(b+1);i++)
+          {
+          int to = count[(key[i]>>shift & 0xff)*nblocks + b]++;
+          nextkey[to] = key[i];
+          next[to] = order[i];
+          }
+      });
+    key.swap(nextkey);
+    order.swap(next);
+    }
+  return order;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to run body(first,last) over the indices 0 to n-1 on a work-stealing pool of nthreads threads.
+// Each thread starts on its own contiguous share and takes chunk-sized pieces off the front of it. Once its
+// share runs dry it steals the back half of the largest share left, so a few large systems can't leave cores idle.
+
+void PARALLELFOR(int n, int nthreads, int chunk, const function<void(int,int)> &body)
+  {
+  PARALLELFOR(n,nthreads,chunk,[&](int first, int last, int) {body(first,last);});
+  }
+
+void PARALLELFOR(int n, int nthreads, int chunk, const function<void(int,int,int)> &body)
+  {
+  if(nthreads<=1 || n<=chunk)  // Not worth starting threads
+    {
+    if(n>0)
+      body(0,n,0);
+    return;
+    }
+  
+  struct share {mutex lock; int lo,hi;};
+  vector<share> shares(nthreads);
+  for(int t=0;t<nthreads;t++)
+    {
+    shares[t].lo = (long)n*t/nthreads;
+    shares[t].hi = (long)n*(t+1)/nthreads;
+    }
+  
+  auto worker = [&](int t)
+    {
+    for(;;)
+      {
+      int lo,hi;
+        {
+        lock_guard<mutex> g(shares[t].lock);
+        lo = shares[t].lo;
+        hi = min(lo+chunk,shares[t].hi);
+        shares[t].lo = hi;
+        }
+      if(lo<hi)
+        {
+        body(lo,hi,t);
+        continue;
+        }
+      
+      // Out of work, so find the biggest share left and steal the back half of it
+      int victim=-1, most=0;
+      for(int v=0;v<nthreads;v++)
+        {
+        lock_guard<mutex> g(shares[v].lock);
+        if(shares[v].hi-shares[v].lo > most)
+          {
+          most = shares[v].hi-shares[v].lo;
+          victim = v;
+          }
+        }
+      if(victim<0)  // Everything is claimed
+        return;
+      
+      // The victim may have moved on since we looked, so take half of whatever it has left now
+        {
+        lock_guard<mutex> g(shares[victim].lock);
+        hi = shares[victim].hi;
+        lo = max(shares[victim].lo,hi-(hi-shares[victim].lo+1)/2);
+        shares[victim].hi = lo;
+        }
+      lock_guard<mutex> g(shares[t].lock);
+      shares[t].lo = lo;
+      shares[t].hi = hi;
+      }
+    };
+  
+  vector<thread> pool;
+  for(int t=1;t<nthreads;t++)
+    pool.push_back(thread(worker,t));
+  worker(0);
+  for(auto &th : pool)
+    th.join();
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to compute Monte Carlo disposition scores. Each group of rows (see FINDGROUPS) is copied out into a
+// batch of replicas, up to MCBATCH rows in all, and every replica gets its own perturbation. The batch is then vetted
+// by one VETRANGE call, so ROWMASKS works on full vectors even for one-TCE systems. Replicas are told apart by
+// renumbering their KICs. As with --stream, each group is vetted on its own. A value of 0 means no result for
+// several metrics, so zeros are never perturbed.
+
+void MCSCORE(const tcestore &tces, const vetconfig &cfg, const mcsigmas &sig, int ntrials, uint64_t seed, vector<double> &pcfrac, int nthreads)
+  {
+  pcfrac.assign(tces.size(),0.0);
+  if(ntrials<=0)
+    return;
+  vector<int> cols;  // Columns with an uncertainty
+  bool fixedephem = true;  // Periods and epochs are the same in every trial, so the pair comparisons are too
+  for(int c=0;c<NDOUBLECOLS;c++)
+    if(sig.abs[c]!=0 || sig.rel[c]!=0)
+      {
+      cols.push_back(c);
+      if(DOUBLECOLS[c]==&tcestore::period || DOUBLECOLS[c]==&tcestore::epoch)
+        fixedephem = false;
+      }
+  
+  vector<int> groupstart = FINDGROUPS(tces);
+  PARALLELFOR(groupstart.size()-1,nthreads,16,[&](int gfirst, int glast)
+    {
+    static thread_local tcestore rep;  // Replicas of the current group
+    static thread_local flagstore fl;
+    static thread_local vector<int> npc,sys;  // Trials each row came out PC, and its system within the group
+    static thread_local vector<uint64_t> key;  // Random number stream of each row
+    for(int g=gfirst;g<glast;g++)
+      {
+      int first = groupstart[g], size = groupstart[g+1]-first;
+      int per = max(1,MCBATCH/size);  // Replicas per batch
+      npc.assign(size,0);
+      sys.resize(size);
+      key.resize(size);
+      for(int k=0;k<size;k++)
+        {
+        int i = first+k;
+        sys[k] = (k==0) ? 0 : sys[k-1] + (tces.kic[i]!=tces.kic[i-1]);
+        key[k] = MCHASH(seed,(uint64_t)(uint32_t)tces.kic[i]<<32 | (uint32_t)tces.pn[i]);
+        if(tces.pn[i]>i+1)  // Reaches back past the start of the catalog, where a second replica would see the first
+          per = 1;
+        }
+      
+      for(int t0=0;t0<ntrials;t0+=per)
+        {
+        int nt = min(per,ntrials-t0), nrows = nt*size;
+        if(t0==0 || nrows!=rep.size())  // Copy the replicas, which later batches of the same size only need to perturb
+          {
+          rep.resize(nrows);  // Exactly, as SECECLIPSE looks at the row after the last
+          for(int r=0;r<nt;r++)
+            for(int k=0;k<size;k++)
+              {
+              int i = first+k, o = r*size+k;
+#define X(col) rep.col[o] = tces.col[i];
+              TCE_INT_COLUMNS(X)
+              TCE_DOUBLE_COLUMNS(X)
+#undef X
+              rep.kic[o] = r*size + sys[k];  // Unique to the system and replica
+              }
+          if(!tces.sysstart.empty())
+            INDEXSYSTEMS(rep);
+          if(fixedephem && size>1)
+            CACHEPAIRS(rep,1,COMPPT,cfg.mission_dur);
+          }
+        for(int c : cols)
+          {
+          const column<double> &src = tces.*DOUBLECOLS[c];
+          column<double> &dst = rep.*DOUBLECOLS[c];
+          for(int r=0;r<nt;r++)
+            for(int k=0;k<size;k++)
+              {
+              double v = src[first+k];
+              if(v!=0)
+                dst[r*size+k] = v + (sig.abs[c] + sig.rel[c]*fabs(v)) * MCGAUSS(key[k],(uint64_t)(t0+r)*NDOUBLECOLS + c);
+              }
+          }
+        fl.resize(nrows);
+        VETRANGE(rep,cfg,fl,0,nrows);
+        for(int r=0;r<nt;r++)
+          for(int k=0;k<size;k++)
+            npc[k] += !ISFP(fl,r*size+k);
+        }
+      for(int k=0;k<size;k++)
+        pcfrac[first+k] = (double)npc[k]/ntrials;
+      }
+    });
+  }
+
+
+// Counter-based random numbers. The n'th 64 bits of stream key are a hash of the two, using the SplitMix64
+// finalizer, so any TCE's numbers can be drawn in any order on any thread.
+
+uint64_t MCHASH(uint64_t key, uint64_t n)
+  {
+  uint64_t z = key ^ (n+1)*0x9e3779b97f4a7c15ull;
+  z = (z ^ (z>>30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z>>27)) * 0x94d049bb133111ebull;
+  return z ^ (z>>31);
+  }
+
+// The n'th standard gaussian deviate of stream key, the inverse normal CDF of one half of a MCHASH. The inverse is
+// interpolated in a table of MCTABLE bins, to within 1.5e-4 sigma, and worked out in full in the outer MCEDGE bins
+// at each end where it curves too fast.
+
+const vector<double> MCINVNORM = []
+  {
+  vector<double> t(MCTABLE+1);
+  for(int k=1;k<MCTABLE;k++)
+    t[k] = -sqrt(2)*INVERFC(2.0*k/MCTABLE);
+  return t;
+  }();
+
+double MCGAUSS(uint64_t key, uint64_t n)
+  {
+  uint32_t x = MCHASH(key,n/2) >> (n&1 ? 32 : 0);
+  int k = x/(0x100000000ull/MCTABLE);
+  if(k<MCEDGE || k>=MCTABLE-MCEDGE)
+    return -sqrt(2)*INVERFC(2.0*(x+0.5)/4294967296.0);
+  double f = (x%(0x100000000ull/MCTABLE) + 0.5)/(0x100000000ull/MCTABLE);
+  return MCINVNORM[k] + f*(MCINVNORM[k+1]-MCINVNORM[k]);
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to compute ephem_match_disp for every TCE. Two TCEs on different stars match if their periods agree
+// (PSIG > cfg.psig_thresh) at a ratio of n:q, with q up to EPHEM_MAXDEN and n/q up to EPHEM_MAXRATIO, and their epochs
+// agree (ESIG > cfg.esig_thresh) modulo the shorter period over q, which is how often the two sets of transits can
+// line up. Stars with positions in coords must also be within EPHEM_RADIUS. Of a matching pair the shallower TCE is
+// flagged, since it is the one whose signal is contamination from the other, and a TCE matching one of the known
+// systems (such as from --ephemlist) is always flagged.
+//
+// Entries with a position are binned on the sky, so a TCE with a position only looks at its neighbours and at the
+// entries with no position. Those are sorted and bucketed by log period, and a TCE only looks at the ones whose
+// period is within the PSIG tolerance of each ratio of its own period.
+
+void EPHEMMATCH(tcestore &tces, const vetconfig &cfg, const coordmap &coords, const vector<ephement> &known, int nthreads)
+  {
+  double plo,phi,elo,ehi;  // Cuts for PSIG and ESIG, see PFRACCUTS
+  PFRACCUTS(cfg.psig_thresh,plo,phi);
+  PFRACCUTS(cfg.esig_thresh,elo,ehi);
+  
+  // Gather the TCEs and known systems, with their positions
+  vector<ephement> ents;
+  for(int i=0;i<tces.size();i++)
+    {
+    ephement e = {tces.period[i],tces.epoch[i],tces.dv_mod_pridepth[i],{0,0,0},tces.kic[i],i};
+    auto c = coords.find(tces.kic[i]);
+    if(c!=coords.end())
+      SETPOS(e,c->second.first,c->second.second);
+    ents.push_back(e);
+    }
+  for(size_t k=0;k<known.size();k++)
+    {
+    ents.push_back(known[k]);
+    ents.back().row = -1;  // Not a row of tces
+    }
+  ents.erase(remove_if(ents.begin(),ents.end(),[](const ephement &e) {return !(e.period>0) || !isfinite(e.period) || !isfinite(e.epoch);}),ents.end());  // Can't match without an ephemeris
+  for(int i=0;i<tces.size();i++)
+    tces.ephem_match_disp[i]=0;
+  if(ents.empty())
+    return;
+  sort(ents.begin(),ents.end(),[](const ephement &a, const ephement &b) {return a.period<b.period;});
+  
+  const double cosradius = cos(EPHEM_RADIUS/3600.0*M_PI/180.0);
+  auto haspos = [](const ephement &e) {return e.pos[0]!=0 || e.pos[1]!=0 || e.pos[2]!=0;};
+  
+  // Whether B, a different star, explains A: B is the brighter source, close enough on the sky if both positions are
+  // known, and its period is n/q or q/n of A's with an epoch that lines up.
+  auto pairmatch = [&](const ephement &A, const ephement &B)
+    {
+    if(&A==&B || (A.kic>=0 && A.kic==B.kic))  // Same star is left to the other tests
+      return false;
+    if(!(B.row<0 || B.depth>A.depth || (B.depth==A.depth && B.row<A.row)))  // B has to be the source of A's signal
+      return false;
+    if(haspos(A) && haspos(B) && A.pos[0]*B.pos[0] + A.pos[1]*B.pos[1] + A.pos[2]*B.pos[2] < cosradius)  // Too far apart on the sky
+      return false;
+    double ps = min(A.period,B.period), pl = max(A.period,B.period);
+    for(int q=1;q<=EPHEM_MAXDEN;q++)
+      {
+      int n = rint(q*pl/ps);
+      if(n>EPHEM_MAXRATIO*q || gcd(n,q)!=1)
+        continue;
+      double de = (A.epoch-B.epoch)/(ps/q);
+      if(!FRACPASS(fabs(de - rint(de)),elo,ehi,cfg.esig_thresh))  // ESIG(A.epoch,B.epoch,ps/q)
+        continue;
+      if(FRACPASS(fabs((ps-q*pl)/ps - rint((ps-q*pl)/ps)),plo,phi,cfg.psig_thresh))  // PSIG(ps,q*pl)
+        return true;
+      }
+    return false;
+    };
+  
+  // Entries with a position are binned on the sky, in cubes of the unit sphere one match radius across, so a TCE only
+  // has to look at its own and the 26 neighbouring cubes
+  const double cell = 2*sin(EPHEM_RADIUS/3600.0*M_PI/180.0/2);
+  auto cellof = [&](const double pos[3], int d) {return (long long)floor(pos[d]/cell) + (1<<20);};
+  auto cellkey = [](long long x, long long y, long long z) {return (x<<42) | (y<<21) | z;};
+  vector<pair<long long,int> > sky;
+  vector<int> nopos,all(ents.size());
+  iota(all.begin(),all.end(),0);
+  for(size_t e=0;e<ents.size();e++)
+    {
+    if(haspos(ents[e]))
+      sky.push_back(make_pair(cellkey(cellof(ents[e].pos,0),cellof(ents[e].pos,1),cellof(ents[e].pos,2)),e));
+    else
+      nopos.push_back(e);
+    }
+  sort(sky.begin(),sky.end());
+  unordered_map<long long,pair<int,int> > skycells;  // Cell key to range in sky
+  for(size_t s=0;s<sky.size();s++)
+    {
+    auto c = skycells.emplace(sky[s].first,make_pair(s,s)).first;
+    c->second.second = s+1;
+    }
+  
+  // Entries without a position can match anything, so they're found by period instead. Bucket by log period, about
+  // one entry per bucket.
+  struct periodindex {vector<int> ids,bucketstart; double logmin,width;};
+  auto buildindex = [&](const vector<int> &ids)
+    {
+    periodindex idx = {ids,vector<int>(ids.size()+2,0),0,1};  // ents is sorted by period, so ids are too
+    if(ids.empty())
+      return idx;
+    idx.logmin = log(ents[ids.front()].period);
+    idx.width = (log(ents[ids.back()].period)-idx.logmin)/ids.size() + 1e-12;
+    for(size_t k=0;k<ids.size();k++)
+      idx.bucketstart[min<int>(ids.size(),int((log(ents[ids[k]].period)-idx.logmin)/idx.width))+1]++;
+    for(size_t b=0;b<=ids.size();b++)
+      idx.bucketstart[b+1] += idx.bucketstart[b];
+    return idx;
+    };
+  const periodindex byperiod = buildindex(all), bypos = buildindex(nopos);
+  
+  // The period ratios to look at, n/q in lowest terms, each way round. Each gives the range of partner periods,
+  // relative to the TCE's own, that could pass PSIG, made a little generous so rounding can't lose a match.
+  struct probe {double lo,hi,loglo,loghi;};
+  vector<probe> probes;
+  auto addprobe = [&](double lo, double hi) {probes.push_back({lo,hi,log(lo),log(hi)});};
+  for(int q=1;q<=EPHEM_MAXDEN;q++)
+    for(int n=q;n<=EPHEM_MAXRATIO*q;n++)
+      if(gcd(n,q)==1)
+        {
+        addprobe((n-phi)/q*(1-1e-9),(n+phi)/q*(1+1e-9));  // Partner period longer by n/q
+        if(n!=q)
+          addprobe(q/(n+phi)*(1-1e-9),q/(n-phi)*(1+1e-9));  // Partner period shorter by n/q
+        }
+  auto scanperiods = [&](const periodindex &idx, const ephement &A)
+    {
+    if(idx.ids.empty())
+      return false;
+    const int nb = idx.ids.size();
+    auto bucket = [&](double logp) {return min(nb,max(0,int((logp-idx.logmin)/idx.width)));};
+    const double loga = log(A.period);
+    for(size_t r=0;r<probes.size();r++)
+      {
+      const double lo = A.period*probes[r].lo, hi = A.period*probes[r].hi;
+      for(int k=idx.bucketstart[bucket(loga+probes[r].loglo)];k<idx.bucketstart[bucket(loga+probes[r].loghi)+1];k++)
+        {
+        const ephement &B = ents[idx.ids[k]];
+        if(B.period>=lo && B.period<=hi && pairmatch(A,B))
+          return true;
+        }
+      }
+    return false;
+    };
+  
+  PARALLELFOR(ents.size(),nthreads,256,[&](int first, int last)
+    {
+    for(int a=first;a<last;a++)
+      {
+      const ephement &A = ents[a];
+      if(A.row<0)  // Known systems aren't flagged
+        continue;
+      bool matched=false;
+      if(haspos(A))
+        {
+        long long cx=cellof(A.pos,0), cy=cellof(A.pos,1), cz=cellof(A.pos,2);
+        for(int d=0;d<27 && !matched;d++)
+          {
+          auto c = skycells.find(cellkey(cx+d%3-1,cy+d/3%3-1,cz+d/9-1));
+          if(c!=skycells.end())
+            for(int s=c->second.first;s<c->second.second && !matched;s++)
+              matched = pairmatch(A,ents[sky[s].second]);
+          }
+        matched = matched || scanperiods(bypos,A);
+        }
+      else
+        matched = scanperiods(byperiod,A);
+      if(matched)
+        tces.ephem_match_disp[A.row]=1;
+      }
+    });
+  }
+
+
+// Set the position of an ephement from RA and Dec in degrees
+
+void SETPOS(ephement &e, double ra, double dec)
+  {
+  ra *= M_PI/180.0;
+  dec *= M_PI/180.0;
+  e.pos[0] = cos(dec)*cos(ra);
+  e.pos[1] = cos(dec)*sin(ra);
+  e.pos[2] = sin(dec);
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to check if TCE is the secondary eclipse of the system
+
+template <class C> void ISSEC(const tcestore &tces, const C &cfg, flagstore &fl, int i, int &secfound, vetstats *stats) {
+
+// If a previous TCE in the system had a sec eclipse detected, and this TCE has the same period / diff epoch as it, then this is the sec eclipse
+if(cfg.disabled & FLAGBIT(THIS_TCE_IS_A_SEC))
+  return;
+for(int k=BEHIND(tces,i);k<i;k++)
+  {
+  ephemcmp m = PAIRCMP(tces,i,k,cfg.mission_dur);
+  if(VETSTATS && stats)
+    stats->pairs[TEST_ISSEC]++;
+  double pratio = tces.period[k]/tces.period[i];  // Modify the period ratio so that it's always the other TCE divided by the current one for this test. That way when pratio>=2, it always means the current TCE is half the period or less of the previous one.
+  
+  double epochthresh = cfg.widthfac*tces.duration[k]/24.0;
+
+  if(fl.not_transit_like[k]==0 && (fl.sig_sec_eclipse[k]==1 || fl.period_is_double[k]==1) && PERIODMATCH(m,cfg) && ((fabs(m.dt) > epochthresh) || (fabs(m.dt) < epochthresh && rint(pratio)>=2 )) && ((fabs(m.dtend) > epochthresh) || (fabs(m.dtend) < epochthresh && rint(pratio)>=2)) && ((m.dt<0 && m.dtend<0) || (m.dt>0 && m.dtend>0) || rint(pratio)>=2) )  // Either same period and differnt epoch as a previous TCE, or half the period and same epoch. Both end up corresponding to the secondary eclipse.
+    {
+    fl.not_transit_like[i]=1;
+    fl.sig_sec_eclipse[i]=1;
+    fl.minorflags[i] |= FLAGBIT(THIS_TCE_IS_A_SEC);
+    secfound=1;  // Note that we found a secondary for this system, so we don't search for more secondaries
+    break;  // Only need to trigger once
+    }
+  }
+
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ 
+// Function to check if the TCE is not transit-like
+ 
+template <class C> void TRANSITLIKE(const tcestore &tces, const C &cfg, flagstore &fl, int i, uint32_t mask, vetstats *stats) {
+
+// The LPP, Marshall, model-shift primary and SES to MES tests only look at this TCE, so they come from its ROWMASKS mask
+const uint32_t tests = (FLAGBIT(TRANSITS_NOT_CONSISTENT)<<1) - FLAGBIT(LPP_DV_TOO_HIGH);  // LPP_DV_TOO_HIGH through TRANSITS_NOT_CONSISTENT
+if(mask & tests)
+  {
+  fl.not_transit_like[i]=1;
+  fl.minorflags[i] |= mask & tests;
+  }
+
+
+// If a previous TCE in the system has the same period as this one, and it was not transit-like, then this one should be too. Also check if previous TCE was transit-like, if this TCE is triggering off the residual of the earlier TCE.
+for(int k=BEHIND(tces,i);k<i;k++)
+  {
+  ephemcmp m = PAIRCMP(tces,i,k,cfg.mission_dur);  // Compute diagnostics on the period and epoch matching
+  if(VETSTATS && stats)
+    stats->pairs[TEST_TRANSITLIKE]++;
+  if(PERIODMATCH(m,cfg))  // This TCE matches the period of a previous TCE in the system
+    {
+    if(fl.not_transit_like[k]==1)  // If the previous TCE was deemed not transit-like, then this TCE should be not transit-like as well
+      {
+      if(cfg.disabled & FLAGBIT(SAME_P_AS_PREV_NTL_TCE))
+        continue;
+      fl.not_transit_like[i]=1;
+      fl.minorflags[i] |= FLAGBIT(SAME_P_AS_PREV_NTL_TCE);
+      break;  // Only need to trigger once
+      }
+    else
+      if(!(cfg.disabled & FLAGBIT(RESID_OF_PREV_TCE)) && (fabs(m.dt) < cfg.widthfac*tces.duration[k]/24.0 || fabs(m.dtend) < cfg.widthfac*tces.duration[k]/24.0 || (m.dt<0 && m.dtend>0) || (m.dt>0 && m.dtend<0)))  // If previous TCE was transit-like, check to see if this TCE is triggering on its residuals, i.e., it's epoch is within two transit durations.
+        {
+        fl.not_transit_like[i]=1;
+        fl.minorflags[i] |= FLAGBIT(RESID_OF_PREV_TCE);
+        break;  // Only need to trigger once
+        }
+    }
+  }
+  
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to check if the TCE has a visible secondary eclipse
+  
+template <class C> void SECECLIPSE(const tcestore &tces, const C &cfg, flagstore &fl, int i, uint32_t mask, vetstats *stats) {
+
+// Look for secondary in DV and Alt detrending, and the Odd-Even tests, from this TCE's ROWMASKS mask.
+// Whether the secondary could be due to a planet, or the period could be double, only counts if that detrending shows a secondary.
+uint32_t flags = mask & (FLAGBIT(SIG_SEC_IN_DV_MODEL_SHIFT) | FLAGBIT(SIG_SEC_IN_ALT_MODEL_SHIFT) | FLAGBIT(DV_ROBO_ODD_EVEN_TEST_FAIL) | FLAGBIT(ALT_ROBO_ODD_EVEN_TEST_FAIL));
+if(mask & FLAGBIT(SIG_SEC_IN_DV_MODEL_SHIFT))
+  flags |= mask & (FLAGBIT(DV_SEC_COULD_BE_DUE_TO_PLANET) | FLAGBIT(DV_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD));
+if(mask & FLAGBIT(SIG_SEC_IN_ALT_MODEL_SHIFT))
+  flags |= mask & (FLAGBIT(ALT_SEC_COULD_BE_DUE_TO_PLANET) | FLAGBIT(ALT_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD));
+if(flags)
+  fl.sig_sec_eclipse[i]=1;
+if(flags & (FLAGBIT(DV_SEC_COULD_BE_DUE_TO_PLANET) | FLAGBIT(ALT_SEC_COULD_BE_DUE_TO_PLANET)))
+  fl.planet_occultation[i]=1;
+if(flags & (FLAGBIT(DV_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD) | FLAGBIT(ALT_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD)))
+  fl.period_is_double[i]=1;
+fl.minorflags[i] |= flags;
+
+
+// Check if subsequent TCE has same period, indicating a secondary eclipse
+for(int k=i+1,last=(cfg.disabled & FLAGBIT(OTHER_TCE_AT_SAME_PERIOD_DIFF_EPOCH)) ? i : AHEAD(tces,i);k<=last;k++)  // Start looking at the next TCE in the system, and every subsequent TCE, through the last TCE in the system
+  {
+  ephemcmp m = PAIRCMP(tces,i,k,cfg.mission_dur);
+  if(VETSTATS && stats)
+    stats->pairs[TEST_SECECLIPSE]++;
+  if(PERIODMATCH(m,cfg) && (fabs(m.dt) > cfg.widthfac*tces.duration[i]/24.0 || (fabs(m.dt) < cfg.widthfac*tces.duration[i]/24.0 && rint(m.ratio)>=2 )) && (fabs(m.dtend) > cfg.widthfac*tces.duration[i]/24.0 || (fabs(m.dtend) < cfg.widthfac*tces.duration[i]/24.0 && rint(m.ratio)>=2)) && ((m.dt<0 && m.dtend<0) || (m.dt>0 && m.dtend>0) || rint(m.ratio)>=2))  // Significant period match, at least 2 transit durations away, and either an insigniicant epoch match or more than a day apart. Put in condition so that if close periods, but some drift, will look for drift across the primary transit
+    {
+    fl.sig_sec_eclipse[i]=1;
+    fl.minorflags[i] |= FLAGBIT(OTHER_TCE_AT_SAME_PERIOD_DIFF_EPOCH);
+    break;  // Only need to trigger this once
+    }
+  }
+
+
+// Now if a secondary was detected, but the period could be double the true period, mark it as not actually having a secondary
+if(fl.period_is_double[i]==1)
+  fl.sig_sec_eclipse[i]=0;
+}
+  
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to compare the period and epoch of row i against row k, from the pair cache if there is one for this mission duration
+
+ephemcmp PAIRCMP(const tcestore &tces, int i, int k, double missiondur)
+  {
+  if(tces.pairstart.empty() || tces.pairdur!=missiondur)
+    return COMPPT(tces.period[i],tces.period[k],tces.epoch[i],tces.epoch[k],missiondur);
+  int lo = BEHIND(tces,i);
+  return tces.pairs[tces.pairstart[i] + k-lo - (k>i ? 1 : 0)];
+  }
+
+
+// Function to fill the pair cache with every comparison the tests could make. Row i is compared against the
+// rows from BEHIND up to it (ISSEC and TRANSITLIKE) and the rows after it up to AHEAD (SECECLIPSE).
+
+void CACHEPAIRS(tcestore &tces, int nthreads, ephemcmp (*cmp)(double,double,double,double,double), double missiondur)
+  {
+  int n = tces.size();
+  vector<int> start(n+1,0);
+  for(int i=0;i<n;i++)
+    {
+    start[i+1] = start[i] + AHEAD(tces,i)-BEHIND(tces,i);
+    }
+  tces.pairs.resize(start[n]);
+  PARALLELFOR(n,nthreads,1024,[&](int first, int last)
+    {
+    for(int i=first;i<last;i++)
+      {
+      int idx = start[i];
+      for(int k=BEHIND(tces,i);idx<start[i+1];k++)
+        if(k!=i)
+          tces.pairs[idx++] = cmp(tces.period[i],tces.period[k],tces.epoch[i],tces.epoch[k],missiondur);
+      }
+    });
+  tces.pairstart.swap(start);
+  tces.pairdur = missiondur;
+  }
+
+
+// The first row that row i is compared against by ISSEC and TRANSITLIKE, and the last that SECECLIPSE compares it
+// against. With a system index these are the ends of its system. Without one they come from the planet numbers as
+// in DR24: the pn-1 rows before it, and the num_planets-pn rows after it when the next row is in the same system.
+
+int BEHIND(const tcestore &tces, int i)
+  {
+  if(!tces.sysstart.empty())
+    return tces.sysstart[tces.sysof[i]];
+  return max(0,i-max(tces.pn[i],1)+1);
+  }
+
+int AHEAD(const tcestore &tces, int i)
+  {
+  if(!tces.sysstart.empty())
+    return tces.sysstart[tces.sysof[i]+1]-1;
+  if(i+1<tces.size() && tces.kic[i]==tces.kic[i+1])  // Only if there are subsequent TCEs belonging to the same KIC. Mostly just a precaution for injection systems.
+    return max(i,min(tces.size()-1,i+tces.num_planets[i]-tces.pn[i]));
+  return i;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The reference engine, for --verify to check VETRANGE against. These are the DR24 tests as the original robovet ran
+// them: one TCE at a time, every test evaluated in turn with the thresholds read from cfg, and every period and epoch
+// comparison worked out afresh with COMPPTREF and PSIG. It has no masks, pair cache, compiled-in thresholds or
+// threads, so leave it alone when speeding up the tests; it is what they are held to. It vets with every test, so
+// cfg.disabled and cfg.fastpath are ignored. It shares the tcestore and the parser that fills it, COUNTPLANETS,
+// and BEHIND and AHEAD, which set the rows each TCE is compared with, with VETRANGE, so it doesn't check those.
+
+void VETREF(const tcestore &tces, const vetconfig &cfg, flagstore &fl)
+  {
+  int secfound=0;  // Int to mark if a secondary has been found in the system
+  int ntces=tces.size();
+  fl.resize(ntces);
+  for(int i=0;i<ntces;i++)
+    {
+    fl.minorflags[i]=0;
+    fl.not_transit_like[i]=fl.sig_sec_eclipse[i]=fl.planet_occultation[i]=fl.period_is_double[i]=fl.centroid_offset[i]=fl.ephemeris_match[i]=0;  // Make sure all flags start at 0 - assumed PC until it fails a test
+    
+    // Let's keep track if we already found a seconary eclipse in the system or not
+    if(i==0 || tces.kic[i]!=tces.kic[i-1] || fl.not_transit_like[i-1]==0)  // If it's the first TCE we're looking at, or if it's a new system, or if a transit-like TCE was found in the system since we last found a secondary, start looking for a secondary again.
+      secfound=0;
+    
+    // Check to see if TCE is a secondary eclipse
+    if(secfound==0)
+      ISSECREF(tces,cfg,fl,i,secfound);
+    
+    // If not a secondary, check to see if TCE is Transit-Like
+    if(fl.not_transit_like[i]==0 && fl.sig_sec_eclipse[i]==0)
+      TRANSITLIKEREF(tces,cfg,fl,i);
+    
+    // Now if it is Transit-Like, check to see if there is a significant secondary eclipse
+    if(fl.not_transit_like[i]==0 && fl.sig_sec_eclipse[i]==0)
+      SECECLIPSEREF(tces,cfg,fl,i);
+    
+    // Apply robo centroid and ephem match dispositions
+    fl.centroid_offset[i] = tces.robo_cent_disp[i];
+    fl.ephemeris_match[i] = tces.ephem_match_disp[i];
+    }
+  }
+
+
+// Period match significance of rows i and k, with the shorter period first as the original COMPPT had it
+
+double PSIGREF(const tcestore &tces, int i, int k)
+  {
+  if(tces.period[i] < tces.period[k])
+    return PSIG(tces.period[i],tces.period[k]);
+  return PSIG(tces.period[k],tces.period[i]);
+  }
+
+
+void ISSECREF(const tcestore &tces, const vetconfig &cfg, flagstore &fl, int i, int &secfound) {
+
+// If a previous TCE in the system had a sec eclipse detected, and this TCE has the same period / diff epoch as it, then this is the sec eclipse
+for(int k=BEHIND(tces,i);k<i;k++)
+  {
+  ephemcmp m = COMPPTREF(tces.period[i],tces.period[k],tces.epoch[i],tces.epoch[k],cfg.mission_dur);
+  double pratio = tces.period[k]/tces.period[i];  // Always the other TCE divided by the current one for this test
+  double epochthresh = cfg.widthfac*tces.duration[k]/24.0;
+  if(fl.not_transit_like[k]==0 && (fl.sig_sec_eclipse[k]==1 || fl.period_is_double[k]==1) && PSIGREF(tces,i,k) > cfg.psig_thresh && ((fabs(m.dt) > epochthresh) || (fabs(m.dt) < epochthresh && rint(pratio)>=2 )) && ((fabs(m.dtend) > epochthresh) || (fabs(m.dtend) < epochthresh && rint(pratio)>=2)) && ((m.dt<0 && m.dtend<0) || (m.dt>0 && m.dtend>0) || rint(pratio)>=2) )  // Either same period and differnt epoch as a previous TCE, or half the period and same epoch
+    {
+    fl.not_transit_like[i]=1;
+    fl.sig_sec_eclipse[i]=1;
+    fl.minorflags[i] |= FLAGBIT(THIS_TCE_IS_A_SEC);
+    secfound=1;
+    break;  // Only need to trigger once
+    }
+  }
+
+}
+
+
+void TRANSITLIKEREF(const tcestore &tces, const vetconfig &cfg, flagstore &fl, int i) {
+
+uint32_t flags=0;
+if(tces.lpp_tps[i] > cfg.lpp_dv_const + cfg.lppsig*cfg.lpp_dv_slope)  // DV LPP Test
+  flags |= FLAGBIT(LPP_DV_TOO_HIGH);
+if(tces.lpp_trap[i] > cfg.lpp_alt_const + cfg.lppsig*cfg.lpp_alt_slope)  // Alt LPP Test
+  flags |= FLAGBIT(LPP_ALT_TOO_HIGH);
+if(tces.marshall[i] > cfg.marshall_max)  // Check Marshall metric
+  flags |= FLAGBIT(MARSHALL_FAIL);
+if(tces.dv_sig_pri[i]/tces.dv_fred[i] < tces.dv_sig_fa[i] && tces.dv_sig_pri[i] > 0)  // Check is primary is significant in DV
+  flags |= FLAGBIT(DV_SIG_PRI_OVER_FRED_TOO_LOW);
+if(tces.dv_sig_pri[i] - tces.dv_sig_ter[i] < tces.dv_del_fa[i] && tces.dv_sig_pri[i] > 0 && tces.dv_sig_ter[i] > 0)  // Check is primary is significantly greater than tertiary in DV. 0 indicates NULL result
+  flags |= FLAGBIT(DV_SIG_PRI_MINUS_SIG_TER_TOO_LOW);
+if(tces.dv_sig_pri[i] - tces.dv_sig_pos[i] < tces.dv_del_fa[i] && tces.dv_sig_pri[i] > 0 && tces.dv_sig_pos[i] > 0)  // Check is primary is significantly greater than positive in DV
+  flags |= FLAGBIT(DV_SIG_PRI_MINUS_SIG_POS_TOO_LOW);
+if(tces.alt_sig_pri[i]/tces.alt_fred[i] < tces.alt_sig_fa[i] && tces.alt_sig_pri[i] > 0)  // Check if primary is significant in ALT
+  flags |= FLAGBIT(ALT_SIG_PRI_OVER_FRED_TOO_LOW);
+if(tces.alt_sig_pri[i] - tces.alt_sig_ter[i] < tces.alt_del_fa[i] && tces.alt_sig_pri[i] > 0 && tces.alt_sig_ter[i] > 0)  // Check is primary is significantly greater than tertiary in ALT
+  flags |= FLAGBIT(ALT_SIG_PRI_MINUS_SIG_TER_TOO_LOW);
+if(tces.alt_sig_pri[i] - tces.alt_sig_pos[i] < tces.alt_del_fa[i] && tces.alt_sig_pri[i] > 0 && tces.alt_sig_pos[i] > 0)  // Check is primary is significantly greater than positive in ALT
+  flags |= FLAGBIT(ALT_SIG_PRI_MINUS_SIG_POS_TOO_LOW);
+if(tces.max_ses_in_mes[i]/tces.mes[i] > cfg.ses_mes_max && tces.period[i] > cfg.long_period)  // Check consistency of transits via SES to MES ratio
+  flags |= FLAGBIT(TRANSITS_NOT_CONSISTENT);
+if(flags)
+  {
+  fl.not_transit_like[i]=1;
+  fl.minorflags[i] |= flags;
+  }
+
+// If a previous TCE in the system has the same period as this one, and it was not transit-like, then this one should be too. Also check if previous TCE was transit-like, if this TCE is triggering off the residual of the earlier TCE.
+for(int k=BEHIND(tces,i);k<i;k++)
+  {
+  ephemcmp m = COMPPTREF(tces.period[i],tces.period[k],tces.epoch[i],tces.epoch[k],cfg.mission_dur);
+  if(PSIGREF(tces,i,k) > cfg.psig_thresh)  // This TCE matches the period of a previous TCE in the system
+    {
+    if(fl.not_transit_like[k]==1)  // If the previous TCE was deemed not transit-like, then this TCE should be not transit-like as well
+      {
+      fl.not_transit_like[i]=1;
+      fl.minorflags[i] |= FLAGBIT(SAME_P_AS_PREV_NTL_TCE);
+      break;  // Only need to trigger once
+      }
+    else
+      if(fabs(m.dt) < cfg.widthfac*tces.duration[k]/24.0 || fabs(m.dtend) < cfg.widthfac*tces.duration[k]/24.0 || (m.dt<0 && m.dtend>0) || (m.dt>0 && m.dtend<0))  // Epoch within two transit durations of a transit-like TCE, so triggering on its residuals
+        {
+        fl.not_transit_like[i]=1;
+        fl.minorflags[i] |= FLAGBIT(RESID_OF_PREV_TCE);
+        break;  // Only need to trigger once
+        }
+    }
+  }
+
+}
+
+
+void SECECLIPSEREF(const tcestore &tces, const vetconfig &cfg, flagstore &fl, int i) {
+
+// Look for secondary in DV detrending
+if(tces.dv_sig_sec[i]/tces.dv_fred[i] > tces.dv_sig_fa[i] && tces.dv_sig_sec[i] > 0)  // See if secondary is significant
+  if(tces.dv_sig_sec[i] - tces.dv_sig_ter[i] > tces.dv_del_fa[i] || tces.dv_sig_ter[i] <= 0)  // If ter measurement exists, check if sec is more significant
+    if(tces.dv_sig_sec[i] - tces.dv_sig_pos[i] > tces.dv_del_fa[i] || tces.dv_sig_pos[i] <= 0)  // If pos measurement exists, check if sec is more significant
+      {
+      fl.sig_sec_eclipse[i]=1;
+      fl.minorflags[i] |= FLAGBIT(SIG_SEC_IN_DV_MODEL_SHIFT);
+      if(tces.dv_alb[i] > 0.0 && tces.dv_alb[i] < 1.0 && tces.dv_rp[i] > 0.0 && tces.dv_rp[i] < 30.0 && tces.dv_mod_secdepth[i] < cfg.occ_depth_frac*tces.dv_mod_pridepth[i] && tces.impact[i] < cfg.occ_impact_max)  // Check to see if occultation could be due to planet
+        {
+        fl.planet_occultation[i]=1;
+        fl.minorflags[i] |= FLAGBIT(DV_SEC_COULD_BE_DUE_TO_PLANET);
+        }
+      if(fabs(0.5 - tces.dv_ph_sec[i])*tces.period[i] < 0.25*tces.duration[i]/24.0 && fabs(tces.dv_sig_pri[i] - tces.dv_sig_sec[i]) < tces.dv_del_fa[i])  // Check to see if secondary could be identical to the transit so that it's really a PC phased at twice the period
+        {
+        fl.period_is_double[i]=1;
+        fl.minorflags[i] |= FLAGBIT(DV_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD);
+        }
+      }
+
+// Look for secondary in Alt detrending
+if(tces.alt_sig_sec[i]/tces.alt_fred[i] > tces.alt_sig_fa[i] && tces.alt_sig_sec[i] > 0)
+  if(tces.alt_sig_sec[i] - tces.alt_sig_ter[i] > tces.alt_del_fa[i] || tces.alt_sig_ter[i] <= 0)
+    if(tces.alt_sig_sec[i] - tces.alt_sig_pos[i] > tces.alt_del_fa[i] || tces.alt_sig_pos[i] <= 0)
+      {
+      fl.sig_sec_eclipse[i]=1;
+      fl.minorflags[i] |= FLAGBIT(SIG_SEC_IN_ALT_MODEL_SHIFT);
+      if(tces.alt_alb[i] > 0.0 && tces.alt_alb[i] < 1.0 && tces.alt_rp[i] > 0.0 && tces.alt_rp[i] < 30.0 && tces.alt_mod_secdepth[i] < cfg.occ_depth_frac*tces.alt_mod_pridepth[i] && tces.impact[i] < cfg.occ_impact_max)
+        {
+        fl.planet_occultation[i]=1;
+        fl.minorflags[i] |= FLAGBIT(ALT_SEC_COULD_BE_DUE_TO_PLANET);
+        }
+      if(fabs(0.5 - tces.alt_ph_sec[i])*tces.period[i] < 0.25*tces.duration[i]/24.0 && fabs(tces.alt_sig_pri[i] - tces.alt_sig_sec[i]) < tces.alt_del_fa[i])
+        {
+        fl.period_is_double[i]=1;
+        fl.minorflags[i] |= FLAGBIT(ALT_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD);
+        }
+      }
+
+// Odd-Even Tests from DV and Chris detrending
+if(tces.period[i] < cfg.long_period && tces.dv_oesig[i] > cfg.oesig_max)
+  {
+  fl.sig_sec_eclipse[i]=1;
+  fl.minorflags[i] |= FLAGBIT(DV_ROBO_ODD_EVEN_TEST_FAIL);
+  }
+if(tces.period[i] < cfg.long_period && tces.alt_oesig[i] > cfg.oesig_max)
+  {
+  fl.sig_sec_eclipse[i]=1;
+  fl.minorflags[i] |= FLAGBIT(ALT_ROBO_ODD_EVEN_TEST_FAIL);
+  }
+
+// Check if subsequent TCE has same period, indicating a secondary eclipse
+for(int k=i+1;k<=AHEAD(tces,i);k++)  // Start looking at the next TCE in the system, and every subsequent TCE, through the last TCE in the system
+  {
+  ephemcmp m = COMPPTREF(tces.period[i],tces.period[k],tces.epoch[i],tces.epoch[k],cfg.mission_dur);
+  double width = cfg.widthfac*tces.duration[i]/24.0;
+  if(PSIGREF(tces,i,k) > cfg.psig_thresh && (fabs(m.dt) > width || (fabs(m.dt) < width && rint(m.ratio)>=2 )) && (fabs(m.dtend) > width || (fabs(m.dtend) < width && rint(m.ratio)>=2)) && ((m.dt<0 && m.dtend<0) || (m.dt>0 && m.dtend>0) || rint(m.ratio)>=2))  // Significant period match, at least 2 transit durations away, and either an insigniicant epoch match or more than a day apart
+    {
+    fl.sig_sec_eclipse[i]=1;
+    fl.minorflags[i] |= FLAGBIT(OTHER_TCE_AT_SAME_PERIOD_DIFF_EPOCH);
+    break;  // Only need to trigger this once
+    }
+  }
+
+// Now if a secondary was detected, but the period could be double the true period, mark it as not actually having a secondary
+if(fl.period_is_double[i]==1)
+  fl.sig_sec_eclipse[i]=0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Function to compute the period match and epoch difference of two periods and epochs. The epoch difference
+// is wrapped to within half a period in one step by WRAPDT, and the period match significance is left to PERIODMATCH.
+
+ephemcmp COMPPT(double P1, double P2, double T1, double T2, double missiondur) {
+
+ephemcmp m;
+if(P1 < P2)
+  {
+  m.pfrac = fabs((P1-P2)/P1 - rint((P1-P2)/P1));  // Period mismatch, as PSIG(P1,P2) sees it
+  m.ratio = P2/P1;  // Period Ratio
+  m.dt = T1 - T2;  // Difference in epoch
+  m.dt = WRAPDT(m.dt,P1);
+  m.dtend = m.dt + int(missiondur/P2)*(rint(m.ratio)*P1-P2);  // Difference in epoch by end of mission
+  }
+else
+  {
+  m.pfrac = fabs((P2-P1)/P2 - rint((P2-P1)/P2));  // Period mismatch, as PSIG(P2,P1) sees it
+  m.ratio = P1/P2;  // Period Ratio
+  m.dt = T2 - T1;  // Difference in epoch
+  m.dt = WRAPDT(m.dt,P2);
+  m.dtend = m.dt + int(missiondur/P1)*(rint(m.ratio)*P2-P1);  // Difference in epoch by end of mission
+  }
+
+return m;
+}
+
+
+// Wrap an epoch difference to within half a period of 0 in one step. Each step of the original loops rounds, so
+// after |dt|/P of them their result can be off from the exact one by that many ulps of |dt|, and dt/P can round
+// to the other side of a half. Where the wrapped difference is within that much of half a period, which side of
+// 0 it lands on depends on those roundings, so it is wrapped with the original loops instead.
+
+double WRAPDT(double dt, double P)
+  {
+  double w = dt - P*rint(dt/P);
+  if(fabs(fabs(w)-0.5*P) > 4*DBL_EPSILON*fabs(dt)*(fabs(dt)/P+1))
+    return w;
+  while(dt > 0.5*P)
+    dt -= P;
+  while(dt < -0.5*P)
+    dt += P;
+  return dt;
+  }
+
+
+// The original COMPPT, with the epoch difference wrapped one period at a time. VETREF compares with it, and
+// CHECKEPHEM holds COMPPT to it.
+
+ephemcmp COMPPTREF(double P1, double P2, double T1, double T2, double missiondur) {
+
+ephemcmp m;
+if(P1 < P2)
+  {
+  m.pfrac = fabs((P1-P2)/P1 - rint((P1-P2)/P1));
+  m.ratio = P2/P1;  // Period Ratio
+  m.dt = T1 - T2;  // Difference in epoch
+  while(m.dt > 0.5*P1)
+    m.dt -= P1;
+  while(m.dt < -0.5*P1)
+    m.dt += P1;
+  m.dtend = m.dt + int(missiondur/P2)*(rint(m.ratio)*P1-P2);  // Difference in epoch by end of mission
+
+  }
+else
+  {
+  m.pfrac = fabs((P2-P1)/P2 - rint((P2-P1)/P2));
+  m.ratio = P1/P2;  // Period Ratio
+  m.dt = T2 - T1;  // Difference in epoch
+  while(m.dt > 0.5*P2)
+    m.dt -= P2;
+  while(m.dt < -0.5*P2)
+    m.dt += P2;
+  m.dtend = m.dt + int(missiondur/P1)*(rint(m.ratio)*P2-P1);  // Difference in epoch by end of mission
+  }
+
+return m;
+}
+
+
+// Function to decide if two periods match, i.e. PSIG > psig_thresh, from the cuts PFRACCUTS worked out
+
+bool PERIODMATCH(const ephemcmp &m, const vetconfig &cfg)
+  {
+  return FRACPASS(m.pfrac,cfg.pfrac_lo,cfg.pfrac_hi,cfg.psig_thresh);
+  }
+
+bool PERIODMATCH(const ephemcmp &m, const dr24config &cfg)
+  {
+  return FRACPASS(m.pfrac,cfg.pfrac_lo,cfg.pfrac_hi,cfg.psig_thresh);
+  }
+
+
+// Function to decide if sqrt(2)*INVERFC(frac) > thresh, i.e. PSIG or ESIG pass, given the PFRACCUTS of thresh
+
+bool FRACPASS(double frac, double lo, double hi, double thresh)
+  {
+  if(frac < lo)
+    return true;
+  if(frac > hi)
+    return false;
+  return sqrt(2)*INVERFC(frac) > thresh;  // Right at the threshold, or NaN
+  }
+
+
+// Function to turn a PSIG threshold into cuts on PSIG's argument, so that period matching needs no transcendentals.
+// PSIG falls as its argument grows, so PSIG > thresh holds up to the largest argument where it still holds, found by
+// bisecting over the doubles in [0,0.5]. The INVERFC approximation is not quite monotonic within an ulp or two of the
+// crossing, so arguments within a relative 1e-12 of it are left to PERIODMATCH to evaluate exactly.
+
+void PFRACCUTS(double thresh, double &lo, double &hi)
+  {
+  auto psig = [](uint64_t bits) {double p; memcpy(&p,&bits,sizeof p); return sqrt(2)*INVERFC(p);};
+  uint64_t good,bad;  // Bit patterns of arguments either side of the crossing. Positive doubles order like their bits.
+  double p=0.0;
+  memcpy(&good,&p,sizeof p);
+  p=0.5;
+  memcpy(&bad,&p,sizeof p);
+  if(!(psig(good) > thresh))  // Nothing matches
+    {
+    lo=hi=-1.0;
+    return;
+    }
+  if(psig(bad) > thresh)  // Everything matches
+    {
+    lo=hi=0.5;
+    return;
+    }
+  while(bad-good>1)
+    {
+    uint64_t mid = good+(bad-good)/2;
+    if(psig(mid) > thresh)
+      good=mid;
+    else
+      bad=mid;
+    }
+  memcpy(&p,&good,sizeof p);
+  lo = p*(1-1e-12);
+  hi = p*(1+1e-12);
+  }
+
+double PSIG(double P1, double P2) {
+  return sqrt(2)*INVERFC(fabs((P1-P2)/P1 - rint((P1-P2)/P1)));
+}
+
+double ESIG(double E1, double E2, double P) {
+  return sqrt(2)*INVERFC(fabs((E1-E2)/P - rint((E1-E2)/P)));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The error function 
+
+double INVERFC(double p) {
+  double x, err, t, pp;
+
+  if (p >= 2.) return -100.;
+  if (p <= 0.0) return 100.;
+
+  pp=(p < 1.0)? p:2.-p;
+  t=sqrt(-2.*log(pp/2));
+
+  x= -0.70711*((2.30753+t*0.27061)/(1+t*(0.99229+t*0.04481))-t);
+
+  for (int j=0;j<2;j++) {
+    err=erfc(x)-pp;
+    x += err/(1.12837916709551257*exp(-x*x)-x*err);
+  }
+  return (p<1.0 ? x:-x);
+}
+
@@ -0,0 +1,423 @@
+/* 
+ * Kepler Q1-Q17 DR24 Robovetter library
+ * 
+ * The vetting tests, with no file handling and no global state, so they can be run inside other programs and
+ * from several threads at once. DR24-RoboVetter.cpp is the robovet command line program built on top of it.
+ * 
+ * Build via: make lib    (librobovetter.a and librobovetter.so)
+ * Link with: -lrobovetter -pthread
+ * 
+ * To vet a catalog, fill in a tcerow per TCE, ordered by KIC and then planet number as in the input file, and call
+ * 
+ *   vetwork work;  // Keep this around, later calls reuse its space
+ *   VET(rows.data(),rows.size(),results.data(),vetconfig(),work);
+ * 
+ * Each tceresult then has the disposition and flags that robovet writes for that TCE. Calls sharing a vetwork
+ * must not overlap, and calls with their own vetwork can run at the same time. After the first call, calls with
+ * no more rows than before and nthreads of 1 don't allocate.
+ * 
+ * The lower level functions below work on a whole tcestore, which is what robovet itself uses.
+ *
+ */
+
+#ifndef ROBOVETTER_H
+#define ROBOVETTER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Result of comparing the periods and epochs of two TCEs
+struct ephemcmp {double pfrac,  // Fractional period mismatch, the argument of PSIG. See PERIODMATCH.
+                       ratio,  // Period ratio, longer over shorter
+                          dt,  // Difference in epoch, wrapped into +/- half the shorter period
+                       dtend;  // Difference in epoch by end of mission
+                };
+
+// Minor descriptive flags, listed in the order the tests can fire them, so writing out the set bits in
+// order gives the same "---" separated comments as appending each name to a string when its test fires.
+#define MINOR_FLAGS(X) \
+  X(THIS_TCE_IS_A_SEC)                                     \
+  X(LPP_DV_TOO_HIGH)                                       \
+  X(LPP_ALT_TOO_HIGH)                                      \
+  X(MARSHALL_FAIL)                                         \
+  X(DV_SIG_PRI_OVER_FRED_TOO_LOW)                          \
+  X(DV_SIG_PRI_MINUS_SIG_TER_TOO_LOW)                      \
+  X(DV_SIG_PRI_MINUS_SIG_POS_TOO_LOW)                      \
+  X(ALT_SIG_PRI_OVER_FRED_TOO_LOW)                         \
+  X(ALT_SIG_PRI_MINUS_SIG_TER_TOO_LOW)                     \
+  X(ALT_SIG_PRI_MINUS_SIG_POS_TOO_LOW)                     \
+  X(TRANSITS_NOT_CONSISTENT)                               \
+  X(SAME_P_AS_PREV_NTL_TCE)                                \
+  X(RESID_OF_PREV_TCE)                                     \
+  X(SIG_SEC_IN_DV_MODEL_SHIFT)                             \
+  X(DV_SEC_COULD_BE_DUE_TO_PLANET)                         \
+  X(DV_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD)   \
+  X(SIG_SEC_IN_ALT_MODEL_SHIFT)                            \
+  X(ALT_SEC_COULD_BE_DUE_TO_PLANET)                        \
+  X(ALT_SEC_SAME_DEPTH_AS_PRI_COULD_BE_TWICE_TRUE_PERIOD)  \
+  X(DV_ROBO_ODD_EVEN_TEST_FAIL)                            \
+  X(ALT_ROBO_ODD_EVEN_TEST_FAIL)                           \
+  X(OTHER_TCE_AT_SAME_PERIOD_DIFF_EPOCH)
+
+enum minorflag {
+#define X(name) name,
+  MINOR_FLAGS(X)
+#undef X
+  NMINORFLAGS};
+const char* const MINORFLAGNAMES[] = {
+#define X(name) #name,
+  MINOR_FLAGS(X)
+#undef X
+  };
+constexpr uint32_t FLAGBIT(minorflag f) {return 1u<<f;}
+
+// Tests that ABLATE leaves out one at a time: the test of each minor flag, then the centroid offset and ephemeris
+// match dispositions taken from the input. Also the bits of vetconfig::disabled.
+const int ABLATE_CENTROID = NMINORFLAGS, ABLATE_EPHEM = NMINORFLAGS+1, NABLATE = NMINORFLAGS+2;
+
+// The tests VETRANGE runs on each TCE, in the order it runs them. Each sets a flag, see vetstats.
+#define VET_TESTS(X) \
+  X(ISSEC)        /* Sets sig_sec_eclipse and not_transit_like */ \
+  X(TRANSITLIKE)  /* Sets not_transit_like */ \
+  X(SECECLIPSE)   /* Sets sig_sec_eclipse */
+
+enum vettest {
+#define X(name) TEST_##name,
+  VET_TESTS(X)
+#undef X
+  NVETTESTS};
+const char* const VETTESTNAMES[] = {
+#define X(name) #name,
+  VET_TESTS(X)
+#undef X
+  };
+
+// Declare constants
+constexpr double PSIG_THRESH = 3.25;   // Period matching threshold
+constexpr double ESIG_THRESH = 2.0;    // Epoch matching threshold
+constexpr double WIDTHFAC = 2.5;       // Transit exclusion width actor
+constexpr double MISSIONDUR = 1600.0;  // Mission duration in days
+constexpr double EPHEM_RADIUS = 60.0;  // Separation in arcsec beyond which TCEs can't ephemeris match, when coordinates are given
+constexpr int EPHEM_MAXRATIO = 50;     // Largest period ratio an ephemeris match can be at
+constexpr int EPHEM_MAXDEN = 3;        // Largest denominator of fractional period ratios, e.g. 3 allows 3:2 and 5:3 but not 5:4
+
+// Tunable thresholds of the tests, by name. The defaults are the DR24 values.
+#define VET_THRESHOLDS(X) \
+  X(psig_thresh,    PSIG_THRESH)           /* Period matching threshold */ \
+  X(esig_thresh,    ESIG_THRESH)           /* Epoch matching threshold, for EPHEMMATCH */ \
+  X(widthfac,       WIDTHFAC)              /* Transit exclusion width factor */ \
+  X(lpp_dv_const,   0.00104504238600969)   /* DV LPP cut is lpp_dv_const + lppsig*lpp_dv_slope, based on fitting gaussian to injections */ \
+  X(lpp_dv_slope,   0.000495720001967656)  \
+  X(lpp_alt_const,  0.000667164262937681)  /* Alt LPP cut is lpp_alt_const + lppsig*lpp_alt_slope */ \
+  X(lpp_alt_slope,  0.000417055294849554)  \
+  X(marshall_max,   10.0)                  /* Marshall metric above this fails */ \
+  X(ses_mes_max,    0.9)                   /* Max SES to MES ratio above this means transits not consistent, for long periods */ \
+  X(oesig_max,      1.70)                  /* Odd-even significance above this fails */ \
+  X(occ_depth_frac, 0.10)                  /* Secondary shallower than this fraction of the primary could be a planet occultation */ \
+  X(occ_impact_max, 0.95)                  /* ...if the impact parameter is also below this */ \
+  X(long_period,    90.0)                  /* The SES to MES test is for periods above this, the odd-even tests for periods below */ \
+  X(mission_dur,    MISSIONDUR)            /* Days over which the epochs of two TCEs with matching periods can drift apart */ \
+  X(lpp_ntces,      20367)                 /* TCEs in the run the LPP cuts are scaled for, see lppsig */
+
+struct vetconfig {
+#define X(name,val) double name = val;
+  VET_THRESHOLDS(X)
+#undef X
+  double pfrac_lo,pfrac_hi;  // psig_thresh as cuts on the fractional period mismatch, see PFRACCUTS
+  double lppsig;  // LPP sigma value, computed based off number of TCEs
+  double lppdv,lppalt;  // The DV and Alt LPP cuts, lpp_*_const + lppsig*lpp_*_slope
+  bool fastpath = true;  // Vet with the DR24 thresholds compiled in when all the thresholds are at their defaults
+  uint32_t disabled = 0;  // Tests to leave out, bit u for test u of ABLATE
+
+  vetconfig() {update();}
+  void update();  // Recompute the derived values after changing thresholds
+  bool isdr24() const;  // All the thresholds are at their defaults
+  };
+const char* const THRESHNAMES[] = {
+#define X(name,val) #name,
+  VET_THRESHOLDS(X)
+#undef X
+  };
+double vetconfig::* const THRESHFIELDS[] = {
+#define X(name,val) &vetconfig::name,
+  VET_THRESHOLDS(X)
+#undef X
+  };
+const int NTHRESH = sizeof(THRESHFIELDS)/sizeof(THRESHFIELDS[0]);
+
+// One column of a tcestore. It either owns its values, or is a view of values that live elsewhere, such as a
+// mapped cache file. Anything that resizes the column takes a copy of the values first, so a view is never resized.
+template <typename T> struct column {
+  std::vector<T> own;
+  T *ptr = nullptr;
+  size_t n = 0;
+
+  column() {}
+  column(const column &c) : own(c.own), ptr(c.viewing() ? c.ptr : own.data()), n(c.n) {}
+  column &operator=(const column &c) {own=c.own; ptr=c.viewing() ? c.ptr : own.data(); n=c.n; return *this;}
+  T &operator[](size_t i) {return ptr[i];}
+  const T &operator[](size_t i) const {return ptr[i];}
+  size_t size() const {return n;}
+  bool viewing() const {return ptr!=own.data();}
+  void view(T *p, size_t len)  // Use the len values at p, which must outlive the column or the next resize
+    {
+    own.clear();
+    ptr = p;
+    n = len;
+    }
+  void resize(size_t len)
+    {
+    if(viewing())
+      own.assign(ptr,ptr+std::min(n,len));
+    own.resize(len);
+    ptr = own.data();
+    n = len;
+    }
+  void gather(const std::vector<int> &order, std::vector<T> &scratch)  // Value i becomes value order[i]. The values
+    {                                                                   // go through scratch, which gets the old space.
+    scratch.resize(order.size());
+    for(size_t i=0;i<order.size();i++)
+      scratch[i] = ptr[order[i]];
+    own.swap(scratch);
+    ptr = own.data();
+    n = own.size();
+    }
+  };
+
+// Declare columnar store of all our data. Every metric gets its own contiguous column so the
+// tests only pull the columns they actually read through the cache, and the store grows with the input.
+#define TCE_INT_COLUMNS(X) \
+  X(kic)               /* KIC number */ \
+  X(pn)                /* Planet Number */ \
+  X(num_planets)       /* Number of TCEs for the given KIC */ \
+  X(robo_cent_disp)    /* 0 = centroid PC, 1 = centroid FP */ \
+  X(ephem_match_disp)  /* 0 = no ephem match, 1 = ephem match identified */
+
+#define TCE_DOUBLE_COLUMNS(X) \
+  X(period)            /* Period of the system in days from TPS */ \
+  X(epoch)             /* Epoch from TPS */ \
+  X(max_ses_in_mes)    /* Max SES actually used in the compuation of the MES */ \
+  X(mes)               /* Max MES from TPS */ \
+  X(duration)          /* Duration of the transit from DV in hours */ \
+  X(impact)            /* Impact parameter of the system from DV */ \
+  X(dv_sig_pri)        /* Significance of primary from  model-shift test on DV flux Data */ \
+  X(dv_sig_sec)        /* Significance of secondary from  model-shift test on DV flux Data */ \
+  X(dv_sig_ter)        /* Significance of tertiary from  model-shift test on DV flux Data */ \
+  X(dv_sig_pos)        /* Significance of positive feature from  model-shift test on DV flux Data */ \
+  X(dv_sig_fa)         /* False Alarm threshold from  model-shift test on DV flux Data */ \
+  X(dv_fred)           /* Red Noise / Gaussian Noise  from  model-shift test on DV flux Data */ \
+  X(dv_del_fa)         /* Delta in sigma value threshold to be considered a distinct feature on DV flux data */ \
+  X(dv_ph_sec)         /* Phase of secondary from  model-shift test on DV flux Data */ \
+  X(dv_mod_pridepth)   /* Depth of primary from DV model-shift */ \
+  X(dv_mod_secdepth)   /* Depth of secondary from DV model-shift */ \
+  X(alt_sig_pri)       /* Significance of primary from  model-shift test on Chris' alternate detrended trapezoid fit data */ \
+  X(alt_sig_sec)       /* Significance of secondary from  model-shift test on Chris' alternate detrended trapezoid fit data */ \
+  X(alt_sig_ter)       /* Significance of tertiary from  model-shift test on Chris' alternate detrended trapezoid fit data */ \
+  X(alt_sig_pos)       /* Significance of positive feature from  model-shift test on Chris' alternate detrended trapezoid fit data */ \
+  X(alt_sig_fa)        /* False Alarm threshold from  model-shift test on Chris' alternate detrended trapezoid fit data */ \
+  X(alt_fred)          /* Red Noise / Gaussian Noise  from  model-shift test on Chris' alternate detrended trapezoid fit data */ \
+  X(alt_del_fa)        /* Delta in sigma value threshold to be considered a distinct feature on alternate detrended trapezoid fit data */ \
+  X(alt_ph_sec)        /* Phase of secondary from  model-shift test on Chris' alternate detrended trapezoid fit data */ \
+  X(alt_mod_pridepth)  /* Depth of primary from  model-shift test on Chris' alternate detrended trapezoid fit data */ \
+  X(alt_mod_secdepth)  /* Depth of secondary from  model-shift test on Chris' alternate detrended trapezoid fit data */ \
+  X(dv_oesig)          /* Odd-Even test done on the DV data. */ \
+  X(alt_oesig)         /* Odd-Even test done on the alt data. */ \
+  X(lpp_tps)           /* Susan's LPP value based on DV detrending */ \
+  X(lpp_trap)          /* Susan's LPP value based on alt detrending (Chris) */ \
+  X(dv_alb)            /* Albedo from secondary eclipse monte carlo using model-shift test on DV data */ \
+  X(dv_rp)             /* Planet Radius from secondary eclipse monte carlo using model-shift test on DV data */ \
+  X(alt_alb)           /* Albedo from secondary eclipse monte carlo using model-shift test on alternate data */ \
+  X(alt_rp)            /* Planet Radius from secondary eclipse monte carlo using model-shift test on alternate data */ \
+  X(marshall)          /* Marshall metric for calculating if at least three transits are transit-like */
+
+struct tcestore {std::vector<std::string> tce;  // TCE string (KIC-PN)
+#define X(col) column<int> col;
+  TCE_INT_COLUMNS(X)
+#undef X
+#define X(col) column<double> col;
+  TCE_DOUBLE_COLUMNS(X)
+#undef X
+
+  std::vector<int> pairstart;  // Optional cache of the COMPPT results for every pair of rows the tests compare, see CACHEPAIRS
+  std::vector<ephemcmp> pairs;
+  double pairdur = MISSIONDUR;  // Mission duration the pair cache was worked out for
+  std::vector<int> sysstart,sysof;  // Optional index of the KIC systems, see INDEXSYSTEMS. The rows of system s are
+                                    // sysstart[s] to sysstart[s+1]-1, and row i is in system sysof[i].
+
+  int size() const {return tce.size();}
+  void copyrow(const tcestore &src, int from, int to)  // Overwrite row to with row from of src
+    {
+    tce[to] = src.tce[from];
+#define X(col) col[to] = src.col[from];
+    TCE_INT_COLUMNS(X)
+    TCE_DOUBLE_COLUMNS(X)
+#undef X
+    }
+  void resize(int n)  // Grow (or shrink) every column together
+    {
+    tce.resize(n);
+    pairstart.clear();
+    sysstart.clear();
+    sysof.clear();
+#define X(col) col.resize(n);
+    TCE_INT_COLUMNS(X)
+    TCE_DOUBLE_COLUMNS(X)
+#undef X
+    }
+  };
+
+// Every double column of a tcestore, and its name, in TCE_DOUBLE_COLUMNS order
+column<double> tcestore::* const DOUBLECOLS[] = {
+#define X(col) &tcestore::col,
+  TCE_DOUBLE_COLUMNS(X)
+#undef X
+  };
+const char* const DOUBLECOLNAMES[] = {
+#define X(col) #col,
+  TCE_DOUBLE_COLUMNS(X)
+#undef X
+  };
+const int NDOUBLECOLS = sizeof(DOUBLECOLS)/sizeof(DOUBLECOLS[0]);
+
+// Uncertainties of the metrics for MCSCORE, by DOUBLECOLS index. Each trial moves a value v by a gaussian deviate
+// with sigma abs + rel*|v|.
+struct mcsigmas {double abs[NDOUBLECOLS] = {},rel[NDOUBLECOLS] = {};
+                };
+
+// A TCE or known system for EPHEMMATCH to match
+struct ephement {double period,epoch,depth;  // Depth decides which of two matching TCEs is the source
+                 double pos[3];  // Unit vector towards the star, or all 0 if unknown
+                 int kic,row;  // KIC, or -1 if unknown, and row in the tcestore, or -1 for known systems
+                };
+typedef std::unordered_map<int,std::pair<double,double> > coordmap;  // RA and Dec in degrees by KIC
+
+// Declare the flags the robovetter sets on each TCE
+struct flagstore {std::vector<int> sig_sec_eclipse,not_transit_like,planet_occultation,centroid_offset,period_is_double,ephemeris_match;  // Final disposition Flags. Made arrays so TCEs in same system can know about each other.
+                  std::vector<uint32_t> minorflags;  // Minor descriptive flags, one bit per minorflag
+
+  void resize(int n)
+    {
+    sig_sec_eclipse.resize(n);
+    not_transit_like.resize(n);
+    planet_occultation.resize(n);
+    centroid_offset.resize(n);
+    period_is_double.resize(n);
+    ephemeris_match.resize(n);
+    minorflags.resize(n);
+    }
+  };
+
+// Counts of what the tests did, from VETALL or VETRANGE when given somewhere to put them. A minor flag's test is
+// evaluated on a TCE when the test function that owns it runs on that TCE and has something to look at: another
+// TCE in the system for the comparisons, and a secondary in that detrending for the tests that qualify one.
+// Without a vetstats the counting costs a test of the pointer per row and pair. Building with VETSTATS 0
+// (make VETSTATS=0) compiles it out of the tests altogether, and any vetstats passed in is left at zero.
+#ifndef VETSTATS
+#define VETSTATS 1
+#endif
+const int NPAIRBINS = 16;
+struct vetstats {uint64_t rows=0,systems=0;
+                 uint64_t calls[NVETTESTS]={},fires[NVETTESTS]={},pairs[NVETTESTS]={};  // TCEs each test ran on and set its flag on, and pairs of TCEs it compared
+                 uint64_t evaluated[NMINORFLAGS]={},fired[NMINORFLAGS]={};  // TCEs each minor flag's test was evaluated on and set on
+                 uint64_t pairbins[NPAIRBINS]={},maxpairs=0;  // Systems by pairs compared, 0 in bin 0 and 2^(b-1) to 2^b-1 in bin b, the last bin open ended
+                 double seconds=0;  // Spent in VETRANGE
+
+  uint64_t totalpairs() const {return pairs[TEST_ISSEC]+pairs[TEST_TRANSITLIKE]+pairs[TEST_SECECLIPSE];}
+  void add(const vetstats&);
+  };
+
+// One TCE for VET, with the same columns as a tcestore. num_planets is worked out by VET. The input file has no
+// alt_rp, so robovet sets it to dv_rp.
+struct tcerow {
+#define X(col) int col;
+  TCE_INT_COLUMNS(X)
+#undef X
+#define X(col) double col;
+  TCE_DOUBLE_COLUMNS(X)
+#undef X
+  };
+
+// VET's verdict on one TCE, the columns robovet writes out plus the flags that lead to them
+struct tceresult {int fp;  // NExScI disposition, 1 = FP, 0 = PC
+                  int not_transit_like,sig_sec_eclipse,centroid_offset,ephemeris_match,planet_occultation,period_is_double;
+                  uint32_t minorflags;  // One bit per minorflag, see FLAGBIT
+                 };
+
+// Space VET keeps between calls, so it only allocates when the catalog grows. One per thread calling VET.
+struct vetwork {tcestore tces;
+                flagstore fl;
+               };
+
+
+// Vet rows[0..n-1] into results[0..n-1] on nthreads threads
+void VET(const tcerow*,int,tceresult*,const vetconfig&,vetwork&,int nthreads=1);
+
+// Work out num_planets, then vet every row of a tcestore into fl on nthreads threads. Given stats, VETALL resizes it
+// to one vetstats per thread and counts into them; without it, counting costs nothing more than a test of the pointer.
+void COUNTPLANETS(tcestore&);
+void VETALL(const tcestore&,const vetconfig&,flagstore&,int,std::vector<vetstats> *stats=nullptr);
+
+// Vet the rows first through last-1, which must start on a group boundary (see FINDGROUPS), on the calling thread
+void VETRANGE(const tcestore&,const vetconfig&,flagstore&,int,int,vetstats *stats=nullptr);
+std::vector<int> FINDGROUPS(const tcestore&);
+// The first row that row i is compared against by ISSEC and TRANSITLIKE, and the last SECECLIPSE compares it against
+int BEHIND(const tcestore&,int), AHEAD(const tcestore&,int);
+bool ISFP(const flagstore&,int);
+
+// Count the PCs in a tcestore under each of a list of configurations into npc, on nthreads threads, for --sweep
+void VETSWEEP(const tcestore&,const std::vector<vetconfig>&,std::vector<int>&,int);
+
+// The reference engine: the DR24 tests one TCE at a time, as the original robovet ran them, with no fast paths.
+// VETREF vets every row into fl on the calling thread, for checking VETRANGE against, see --verify.
+void VETREF(const tcestore&,const vetconfig&,flagstore&);
+
+// Leave-one-out ablation. Given the flags of a full vet, sets bit u of flips[i] when row i gets the other disposition
+// from vetting without test u, counting the effect on later rows of the system through ISSEC and TRANSITLIKE.
+void ABLATE(const tcestore&,const vetconfig&,const flagstore&,std::vector<uint64_t> &flips,int nthreads);
+
+// Incremental vetting. HASHGROUPS hashes every input value the results of each group depend on, so a group with the
+// same hash as in an earlier run gets the same flags. VETGROUPS vets the groups with need set into fl, leaving the
+// other rows of fl alone, and sets need for any other groups it had to vet with them.
+std::vector<uint64_t> HASHGROUPS(const tcestore&,const std::vector<int>&,int);
+void VETGROUPS(const tcestore&,const vetconfig&,flagstore&,const std::vector<int>&,std::vector<char>&,int,std::vector<vetstats> *stats=nullptr);
+
+// Monte Carlo disposition scores. Vet every group of rows ntrials times with its metrics perturbed within sigmas,
+// on nthreads threads, and put the fraction of trials in which each row came out PC in pcfrac. The perturbations
+// of a TCE depend only on the seed, its KIC and planet number, and the trial, so scores don't depend on the
+// number of threads or on the other TCEs in the file.
+void MCSCORE(const tcestore&,const vetconfig&,const mcsigmas&,int,uint64_t,std::vector<double>&,int);
+double MCGAUSS(uint64_t,uint64_t);
+
+// Sort the rows of a tcestore, which may come in any order, by KIC and then planet number, and index its systems.
+// Afterwards order[i] is the original row of row i. The key of a row is its KIC and planet number packed into 64 bits.
+// With a system index each TCE is compared against the rest of its KIC system, whatever the planet numbers are.
+// Without one, as in DR24, the rows compared are worked out from the planet numbers, which assumes the rows are
+// already sorted and numbered 1 to n in each system.
+void SORTSYSTEMS(tcestore&,std::vector<int> &order,int nthreads);
+void INDEXSYSTEMS(tcestore&);
+std::vector<int> RADIXSORT(const std::vector<uint64_t>&,int);
+void GATHERROWS(tcestore&,const std::vector<int>&,int);
+
+// Compute ephem_match_disp for every row, against the other rows and a list of known systems, on nthreads threads
+void EPHEMMATCH(tcestore&,const vetconfig&,const coordmap&,const std::vector<ephement>&,int);
+void SETPOS(ephement&,double,double);
+
+// Period and epoch comparisons. CACHEPAIRS works out every one the tests will make ahead of time, which pays off
+// when the same tcestore is vetted more than once.
+ephemcmp COMPPT(double,double,double,double,double missiondur=MISSIONDUR), COMPPTREF(double,double,double,double,double missiondur=MISSIONDUR);
+void CACHEPAIRS(tcestore&,int,ephemcmp (*)(double,double,double,double,double) = COMPPT,double missiondur=MISSIONDUR);
+bool PERIODMATCH(const ephemcmp&,const vetconfig&);
+void PFRACCUTS(double,double&,double&);
+double INVERFC(double), PSIG(double,double), ESIG(double,double,double);
+
+// Run body(first,last) over the indices 0 to n-1 on a work-stealing pool of nthreads threads. The second form
+// also passes the number of the pool thread running it, 0 to nthreads-1, with 0 the calling thread.
+void PARALLELFOR(int,int,int,const std::function<void(int,int)>&);
+void PARALLELFOR(int,int,int,const std::function<void(int,int,int)>&);
+
+#endif